@@ -0,0 +1,409 @@
+// Reference Linux host client for ZHNetwork serial bridge (see startBridge() in README.md).
+// Build: g++ -O2 -std=c++11 -o zhnetwork_bridge zhnetwork_bridge.cpp
+// Usage: zhnetwork_bridge <serial port> [baud rate] [-q] [-l <max message length>]
+//
+// Received messages, send results, statuses and statistics are printed one per line.
+// Commands are read from stdin one per line (all lines read at once are sent as one batch):
+//   broadcast <text>
+//   unicast <MAC> <text>
+//   confirm <MAC> <text>
+//   group <group> <text>
+//   statistics
+// With -q only number of received frames per second is printed.
+// With -l longer messages are rejected by the client (ZHNETWORK_MAX_MESSAGE_LENGTH - 1 of the node, 199 by default).
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/select.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+// Must be the same as in ZHNetwork.h.
+enum
+{
+    BROADCAST = 1,
+    UNICAST,
+    UNICAST_WITH_CONFIRM,
+    GROUP_MESSAGE = 9
+};
+enum
+{
+    BRIDGE_MESSAGE = 0x01,
+    BRIDGE_SEND_RESULT,
+    BRIDGE_STATUS,
+    BRIDGE_STATISTICS,
+    BRIDGE_SEND = 0x81,
+    BRIDGE_GET_STATISTICS
+};
+const uint16_t maxFrameSize{512}; // ZHNETWORK_BRIDGE_FRAME_SIZE.
+
+static uint64_t receivedFrames{0};
+static uint64_t brokenFrames{0};
+static uint16_t reference{0};
+static size_t maxMessageLength{199}; // ZHNETWORK_MAX_MESSAGE_LENGTH - 1.
+
+static uint16_t getCRC16(const uint8_t *data, const size_t length)
+{
+    uint16_t crc{0xFFFF};
+    for (size_t i{0}; i < length; ++i)
+    {
+        crc ^= data[i] << 8;
+        for (uint8_t j{0}; j < 8; ++j)
+            crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+    return crc;
+}
+
+static std::vector<uint8_t> encodeFrame(std::vector<uint8_t> data)
+{
+    uint16_t crc = getCRC16(data.data(), data.size());
+    data.push_back(crc & 0xFF);
+    data.push_back(crc >> 8);
+    std::vector<uint8_t> encoded(1);
+    size_t codeIndex{0};
+    uint8_t code{1};
+    for (uint8_t byte : data)
+    {
+        if (byte)
+        {
+            encoded.push_back(byte);
+            ++code;
+        }
+        if (!byte || code == 0xFF)
+        {
+            encoded[codeIndex] = code;
+            code = 1;
+            codeIndex = encoded.size();
+            encoded.push_back(0);
+        }
+    }
+    encoded[codeIndex] = code;
+    encoded.push_back(0);
+    return encoded;
+}
+
+static size_t decodeFrame(uint8_t *data, const size_t length)
+{
+    size_t decodedLength{0};
+    for (size_t i{0}; i < length;)
+    {
+        uint8_t code = data[i++];
+        if (!code || i + code - 1 > length)
+            return 0;
+        for (uint8_t j{1}; j < code; ++j)
+            data[decodedLength++] = data[i++];
+        if (code < 0xFF && i < length)
+            data[decodedLength++] = 0;
+    }
+    if (decodedLength < 3 || getCRC16(data, decodedLength - 2) != (data[decodedLength - 2] | data[decodedLength - 1] << 8))
+        return 0;
+    return decodedLength - 2;
+}
+
+static const char *getStatusName(const uint8_t status)
+{
+    static const char *names[]{"UNKNOWN", "QUEUED", "SENT", "DELIVERED", "FAILED_NO_ROUTE", "FAILED_NO_CONFIRM", "FAILED_QUEUE_FULL"};
+    return status < sizeof(names) / sizeof(names[0]) ? names[status] : "?";
+}
+
+static uint32_t getUint32(const uint8_t *data)
+{
+    return data[0] | data[1] << 8 | data[2] << 16 | (uint32_t)data[3] << 24;
+}
+
+static void printFrame(const uint8_t *data, const size_t length)
+{
+    switch (data[0])
+    {
+    case BRIDGE_MESSAGE:
+        if (length < 13 || length < 13u + data[12])
+            break;
+        printf("MESSAGE type=%s id=%u from=%02X%02X%02X%02X%02X%02X group=%u data=%.*s\n",
+               data[1] == BROADCAST ? "BROADCAST" : data[1] == GROUP_MESSAGE ? "GROUP"
+                                                                            : "UNICAST",
+               data[2] | data[3] << 8, data[4], data[5], data[6], data[7], data[8], data[9], data[10] | data[11] << 8, data[12], (const char *)data + 13);
+        return;
+    case BRIDGE_SEND_RESULT:
+        if (length < 5)
+            break;
+        printf("SENT reference=%u id=%u%s\n", data[1] | data[2] << 8, data[3] | data[4] << 8, data[3] | data[4] ? "" : " (not queued)");
+        return;
+    case BRIDGE_STATUS:
+        if (length < 4)
+            break;
+        printf("STATUS id=%u status=%s\n", data[1] | data[2] << 8, getStatusName(data[3]));
+        return;
+    case BRIDGE_STATISTICS:
+        if (length < 41)
+            break;
+        printf("STATISTICS received=%u duplicate=%u dropped=%u sent=%u failed=%u bridge_errors=%u bridge_overflows=%u slotted=%u flood_sent=%u flood_received=%u\n",
+               getUint32(data + 1), getUint32(data + 5), getUint32(data + 9), getUint32(data + 13), getUint32(data + 17), getUint32(data + 21), getUint32(data + 25), getUint32(data + 29),
+               getUint32(data + 33), getUint32(data + 37));
+        return;
+    default:
+        break;
+    }
+    printf("UNKNOWN frame type=0x%02X length=%zu\n", data[0], length);
+}
+
+static bool parseMAC(const char *string, uint8_t *mac)
+{
+    unsigned int value[6];
+    if (sscanf(string, "%2x%2x%2x%2x%2x%2x", &value[0], &value[1], &value[2], &value[3], &value[4], &value[5]) != 6)
+        return false;
+    for (int i{0}; i < 6; ++i)
+        mac[i] = value[i];
+    return true;
+}
+
+static bool addRecord(std::vector<uint8_t> &batch, const std::string &line)
+{
+    char command[16]{0};
+    char argument[32]{0};
+    int offset{0};
+    uint8_t type{0};
+    uint8_t target[6]{0};
+    if (sscanf(line.c_str(), "%15s %n", command, &offset) != 1)
+        return false;
+    if (!strcmp(command, "broadcast"))
+        type = BROADCAST;
+    else if (!strcmp(command, "unicast") || !strcmp(command, "confirm") || !strcmp(command, "group"))
+    {
+        int next{0};
+        if (sscanf(line.c_str() + offset, "%31s %n", argument, &next) != 1)
+            return false;
+        offset += next;
+        if (!strcmp(command, "group"))
+        {
+            type = GROUP_MESSAGE;
+            unsigned long group = strtoul(argument, nullptr, 0);
+            target[0] = group & 0xFF;
+            target[1] = group >> 8;
+        }
+        else
+        {
+            type = strcmp(command, "unicast") ? UNICAST_WITH_CONFIRM : UNICAST;
+            if (!parseMAC(argument, target))
+                return false;
+        }
+    }
+    else
+        return false;
+    std::string text = line.substr(offset);
+    if (text.size() > maxMessageLength)
+        return false;
+    ++reference;
+    batch.push_back(type);
+    batch.push_back(reference & 0xFF);
+    batch.push_back(reference >> 8);
+    batch.insert(batch.end(), target, target + 6);
+    batch.push_back(text.size());
+    batch.insert(batch.end(), text.begin(), text.end());
+    printf("QUEUED reference=%u\n", reference);
+    return true;
+}
+
+static void writeAll(const int port, const std::vector<uint8_t> &data)
+{
+    for (size_t written{0}; written < data.size();)
+    {
+        ssize_t result = write(port, data.data() + written, data.size() - written);
+        if (result > 0)
+            written += result;
+        else
+        {
+            fd_set writeSet;
+            FD_ZERO(&writeSet);
+            FD_SET(port, &writeSet);
+            select(port + 1, nullptr, &writeSet, nullptr, nullptr);
+        }
+    }
+}
+
+static void sendBatch(const int port, std::vector<uint8_t> &batch)
+{
+    if (batch.size() > 1)
+        writeAll(port, encodeFrame(batch));
+    batch.assign(1, BRIDGE_SEND);
+}
+
+static void processCommands(const int port, std::string &input)
+{
+    std::vector<uint8_t> batch(1, BRIDGE_SEND);
+    for (size_t end; (end = input.find('\n')) != std::string::npos; input.erase(0, end + 1))
+    {
+        std::string line = input.substr(0, end);
+        if (line == "statistics")
+        {
+            writeAll(port, encodeFrame(std::vector<uint8_t>(1, BRIDGE_GET_STATISTICS)));
+            continue;
+        }
+        if (line.empty())
+            continue;
+        size_t size = batch.size();
+        if (!addRecord(batch, line))
+        {
+            fprintf(stderr, "Wrong command: %s\n", line.c_str());
+            continue;
+        }
+        if (batch.size() + 2 + batch.size() / 254 + 2 > maxFrameSize) // Frame is full. Send previous records.
+        {
+            std::vector<uint8_t> record(batch.begin() + size, batch.end());
+            batch.resize(size);
+            sendBatch(port, batch);
+            batch.insert(batch.end(), record.begin(), record.end());
+        }
+    }
+    sendBatch(port, batch);
+}
+
+static speed_t getSpeed(const long baudRate)
+{
+    switch (baudRate)
+    {
+    case 115200:
+        return B115200;
+    case 230400:
+        return B230400;
+    case 460800:
+        return B460800;
+    case 921600:
+        return B921600;
+    case 1000000:
+        return B1000000;
+    case 1500000:
+        return B1500000;
+    case 2000000:
+        return B2000000;
+    default:
+        return 0;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "Usage: %s <serial port> [baud rate] [-q] [-l <max message length>]\n", argv[0]);
+        return 1;
+    }
+    long baudRate{115200};
+    bool quiet{false};
+    for (int i{2}; i < argc; ++i)
+        if (!strcmp(argv[i], "-q"))
+            quiet = true;
+        else if (!strcmp(argv[i], "-l") && i + 1 < argc)
+            maxMessageLength = strtoul(argv[++i], nullptr, 10);
+        else
+            baudRate = strtol(argv[i], nullptr, 10);
+    if (!maxMessageLength || maxMessageLength > 213)
+    {
+        fprintf(stderr, "Max message length must be 1-213.\n");
+        return 1;
+    }
+    speed_t speed = getSpeed(baudRate);
+    if (!speed)
+    {
+        fprintf(stderr, "Unsupported baud rate %ld.\n", baudRate);
+        return 1;
+    }
+    int port = open(argv[1], O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (port < 0)
+    {
+        perror(argv[1]);
+        return 1;
+    }
+    termios settings;
+    if (!tcgetattr(port, &settings))
+    {
+        cfmakeraw(&settings);
+        cfsetispeed(&settings, speed);
+        cfsetospeed(&settings, speed);
+        settings.c_cflag |= CLOCAL | CREAD;
+        tcsetattr(port, TCSANOW, &settings);
+    }
+    setvbuf(stdout, nullptr, _IOFBF, 1 << 16);
+    std::vector<uint8_t> frame;
+    frame.reserve(maxFrameSize);
+    bool frameOverflow{false};
+    std::string input;
+    bool inputOpen{true};
+    uint8_t buffer[1 << 16];
+    timespec lastReport;
+    clock_gettime(CLOCK_MONOTONIC, &lastReport);
+    uint64_t lastReceivedFrames{0};
+    while (true)
+    {
+        fd_set readSet;
+        FD_ZERO(&readSet);
+        FD_SET(port, &readSet);
+        if (inputOpen)
+            FD_SET(STDIN_FILENO, &readSet);
+        timeval timeout{1, 0};
+        if (select(port + 1, &readSet, nullptr, nullptr, &timeout) < 0)
+            break;
+        if (FD_ISSET(port, &readSet))
+        {
+            ssize_t length = read(port, buffer, sizeof(buffer));
+            if (length == 0 || (length < 0 && errno != EAGAIN && errno != EINTR))
+                break;
+            for (ssize_t i{0}; i < length; ++i)
+            {
+                if (buffer[i])
+                {
+                    if (frame.size() < maxFrameSize)
+                        frame.push_back(buffer[i]);
+                    else
+                        frameOverflow = true;
+                    continue;
+                }
+                size_t decodedLength = frameOverflow ? 0 : decodeFrame(frame.data(), frame.size());
+                if (decodedLength)
+                {
+                    ++receivedFrames;
+                    if (!quiet)
+                        printFrame(frame.data(), decodedLength);
+                }
+                else if (!frame.empty() || frameOverflow)
+                    ++brokenFrames;
+                frame.clear();
+                frameOverflow = false;
+            }
+            if (!quiet)
+                fflush(stdout);
+        }
+        if (inputOpen && FD_ISSET(STDIN_FILENO, &readSet))
+        {
+            char text[4096];
+            ssize_t length = read(STDIN_FILENO, text, sizeof(text));
+            if (length <= 0)
+                inputOpen = false;
+            else
+            {
+                input.append(text, length);
+                processCommands(port, input);
+                fflush(stdout);
+            }
+        }
+        timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if (quiet && now.tv_sec > lastReport.tv_sec)
+        {
+            double seconds = (now.tv_sec - lastReport.tv_sec) + (now.tv_nsec - lastReport.tv_nsec) / 1e9;
+            printf("%.0f frames/s, %llu received, %llu broken\n", (receivedFrames - lastReceivedFrames) / seconds, (unsigned long long)receivedFrames, (unsigned long long)brokenFrames);
+            fflush(stdout);
+            lastReport = now;
+            lastReceivedFrames = receivedFrames;
+        }
+    }
+    fflush(stdout);
+    close(port);
+    return 0;
+}
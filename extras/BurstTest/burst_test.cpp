@@ -0,0 +1,123 @@
+// Host test of receive bursts with different maintenance budgets (see setMaintenanceBudget() in README.md).
+// Build: g++ -O2 -std=gnu++17 -DESP8266 -I../HostStubs -I../../src -o burst_test burst_test.cpp ../../src/ZHNetwork.cpp
+// Usage: burst_test [frames per burst] [frame interval, µs] [loop() work, µs] [callback work, µs]
+//
+// A node receives bursts of unicast frames while its loop() calls maintenance() and then does other work. Time is virtual.
+// For each budget the number of dropped frames (full incoming queue), latency from reception to receiving callback
+// and time needed to drain a burst are printed. Budget with 1 incoming frame per call is the previous behavior.
+// Exit code is 1 if the default budget drops more frames or drains bursts slower than the previous behavior.
+
+#include <cstdio>
+#include <cstdlib>
+#include "ZHNetwork.h"
+
+typedef struct
+{
+    const char *name;
+    uint8_t incoming;
+    uint16_t timeSlice;
+} scenario_t;
+
+typedef struct
+{
+    uint32_t frames{0};
+    uint32_t delivered{0};
+    uint32_t dropped{0};
+    uint64_t latency{0};
+    uint64_t maxLatency{0};
+    uint64_t drainTime{0};
+} result_t;
+
+const uint8_t numberOfBursts{10};
+const uint8_t numberOfSenders{4};
+
+ZHNetwork myNet;
+uint32_t framesPerBurst{40};
+uint32_t frameInterval{300};
+uint32_t loopWork{10000};
+uint32_t callbackWork{100};
+std::vector<uint64_t> arrivalTime;
+result_t result;
+uint64_t lastDeliveryTime{0};
+
+result_t runScenario(const uint16_t index, const scenario_t &scenario)
+{
+    maintenance_budget_t budget;
+    budget.incoming = scenario.incoming;
+    budget.timeSlice = scenario.timeSlice;
+    myNet.setMaintenanceBudget(budget);
+    result = result_t();
+    arrivalTime.clear();
+    uint32_t droppedFrames = myNet.getStatistics().droppedFrames;
+    uint16_t messageID[numberOfSenders]{0};
+    for (uint8_t burst{0}; burst < numberOfBursts; ++burst)
+    {
+        uint64_t burstStart = host::time + 1000000;
+        uint32_t frame{0};
+        while (host::time < burstStart + 1000000) // Bursts are 1 s apart.
+        {
+            while (frame < framesPerBurst && burstStart + frame * frameInterval <= host::time)
+            {
+                transmitted_data_t transmittedData;
+                transmittedData.messageType = UNICAST;
+                transmittedData.messageID = messageID[frame % numberOfSenders]++;
+                strcpy(transmittedData.netName, "TEST");
+                memcpy(transmittedData.originalTargetMAC, host::mac, 6);
+                const uint8_t senderMAC[6]{0x02, 0xBB, (uint8_t)index, 0x00, 0x00, (uint8_t)(frame % numberOfSenders)};
+                memcpy(transmittedData.originalSenderMAC, senderMAC, 6);
+                snprintf(transmittedData.message, sizeof(transmittedData.message), "%u", (uint32_t)arrivalTime.size());
+                arrivalTime.push_back(burstStart + frame * frameInterval);
+                host::receive(senderMAC, &transmittedData, sizeof(transmitted_data_t));
+                ++frame;
+            }
+            myNet.maintenance();
+            host::time += loopWork;
+        }
+        if (lastDeliveryTime > burstStart)
+            result.drainTime += lastDeliveryTime - burstStart;
+    }
+    result.frames = numberOfBursts * framesPerBurst;
+    result.dropped = myNet.getStatistics().droppedFrames - droppedFrames;
+    return result;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc > 1)
+        framesPerBurst = strtoul(argv[1], nullptr, 0);
+    if (argc > 2)
+        frameInterval = strtoul(argv[2], nullptr, 0);
+    if (argc > 3)
+        loopWork = strtoul(argv[3], nullptr, 0);
+    if (argc > 4)
+        callbackWork = strtoul(argv[4], nullptr, 0);
+    myNet.begin("TEST");
+    myNet.setOnUnicastReceivingCallback([](const char *data, const uint8_t *)
+                                        {
+                                            host::time += callbackWork;
+                                            uint64_t latency = host::time - arrivalTime[strtoul(data, nullptr, 10)];
+                                            ++result.delivered;
+                                            result.latency += latency;
+                                            if (latency > result.maxLatency)
+                                                result.maxLatency = latency;
+                                            lastDeliveryTime = host::time; });
+    const scenario_t scenarios[]{
+        {"1 frame per call (previous)", 1, 0},
+        {"10 frames per call (default)", 10, 0},
+        {"20 frames per call", 20, 0},
+        {"20 frames per call, 0.5 ms slice", 20, 500},
+    };
+    printf("%u bursts of %u frames every %u µs, loop() work %u µs, callback work %u µs, incoming queue %u\n", numberOfBursts, framesPerBurst,
+           frameInterval, loopWork, callbackWork, myNet.getQueueLimits().incoming);
+    result_t results[sizeof(scenarios) / sizeof(scenario_t)];
+    for (uint16_t i{0}; i < sizeof(scenarios) / sizeof(scenario_t); ++i)
+    {
+        results[i] = runScenario(i + 1, scenarios[i]);
+        printf("%-32s delivered %5u dropped %5u latency avg %7.2f ms max %7.2f ms drain %7.2f ms\n", scenarios[i].name, results[i].delivered,
+               results[i].dropped, results[i].delivered ? results[i].latency / 1000.0 / results[i].delivered : 0.0, results[i].maxLatency / 1000.0,
+               results[i].drainTime / 1000.0 / numberOfBursts);
+    }
+    bool passed = results[1].dropped <= results[0].dropped && results[1].drainTime <= results[0].drainTime;
+    printf("%s\n", passed ? "PASSED" : "FAILED");
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,84 @@
+// Benchmark of messages compression (see setCompression() in README.md): compression ratio and time per frame.
+// ESP8266/ESP32: upload as Arduino sketch, results are printed to serial port at 115200.
+// Host: g++ -O2 -std=gnu++17 -x c++ -DESP8266 -I../HostStubs -I../../src -o compression_benchmark CompressionBenchmark.ino ../../src/ZHNetwork.cpp
+//
+// Ratio includes the length byte of compressed message. Messages not made shorter by compression are sent uncompressed (ratio 1.00).
+
+#include <Arduino.h>
+#if !defined(ARDUINO)
+#include <chrono>
+#endif
+#include "ZHNetwork.h"
+
+#if defined(ARDUINO)
+const uint16_t numberOfIterations{200};
+#else
+const uint16_t numberOfIterations{20000};
+#endif
+
+const char *const samples[]{
+    "{\"state\":\"ON\"}",
+    "{\"state\":\"OFF\",\"brightness\":128,\"color\":\"FF8000\"}",
+    "{\"temperature\":23.45,\"humidity\":56.10,\"pressure\":1013.2,\"battery\":87}",
+    "{\"type\":\"sensor\",\"mac\":\"A4CF12AB34CD\",\"temperature\":21.5,\"humidity\":40,\"voltage\":3.28,\"online\":true}",
+    "{\"type\":\"switch\",\"name\":\"Kitchen light\",\"status\":\"online\",\"state\":\"ON\",\"mode\":\"auto\",\"power\":12.5,\"value\":1}",
+    "Hello world!",
+    "7f3a91c2e4b8d0561a2f9e7c3b8d4a60",
+};
+
+uint32_t getTime()
+{
+#if defined(ARDUINO)
+    return micros();
+#else
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+void setup()
+{
+    Serial.begin(115200);
+    Serial.println();
+    Serial.println("Length  Compressed  Ratio  Compression, us  Decompression, us");
+    for (const char *sample : samples)
+    {
+        uint8_t compressed[ZHNETWORK_MAX_MESSAGE_LENGTH]{0};
+        char decompressed[ZHNETWORK_MAX_MESSAGE_LENGTH]{0};
+        uint8_t length{0};
+        uint32_t startTime = getTime();
+        for (uint16_t i{0}; i < numberOfIterations; ++i)
+            length = ZHNetwork::compressMessage(sample, compressed);
+        uint32_t compressionTime = getTime() - startTime;
+        uint32_t decompressionTime{0};
+        if (length)
+        {
+            startTime = getTime();
+            for (uint16_t i{0}; i < numberOfIterations; ++i)
+                ZHNetwork::decompressMessage(compressed, length, decompressed);
+            decompressionTime = getTime() - startTime;
+            if (strcmp(decompressed, sample))
+            {
+                Serial.print("Decompression failed: ");
+                Serial.println(sample);
+                continue;
+            }
+        }
+        char line[100];
+        snprintf(line, sizeof(line), "%6u  %10u  %5.2f  %15.2f  %17.2f", (unsigned)strlen(sample), length ? length + 1 : (unsigned)strlen(sample),
+                 length ? (length + 1.0) / strlen(sample) : 1.0, (double)compressionTime / numberOfIterations, (double)decompressionTime / numberOfIterations);
+        Serial.println(line);
+        yield();
+    }
+}
+
+void loop()
+{
+}
+
+#if !defined(ARDUINO)
+int main()
+{
+    setup();
+    return 0;
+}
+#endif
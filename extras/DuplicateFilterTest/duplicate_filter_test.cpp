@@ -0,0 +1,190 @@
+// Host test of ZHNetwork duplicate filter compared with the previous scheme (one ring of 10 last message IDs for all senders
+// and random message IDs).
+// Build: g++ -O2 -std=gnu++17 -DESP8266 -I../HostStubs -I../../src -o duplicate_filter_test duplicate_filter_test.cpp ../../src/ZHNetwork.cpp
+// Usage: duplicate_filter_test [seed]
+//
+// Frames are delivered to ZHNetwork through the ESP-NOW receive callback. Each message may arrive several times (copies
+// forwarded by different neighbors) and copies are delayed by up to 20 frames, so messages arrive out of order.
+// For each scenario the number of falsely dropped messages (no copy delivered) and delivered duplicates is printed.
+// Exit code is 1 if ZHNetwork falsely drops or delivers duplicates where the filter guarantees it does not
+// (no more than ZHNETWORK_DUPLICATE_FILTER_SIZE senders and copies within 32 messages of the same sender).
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include "ZHNetwork.h"
+
+typedef struct
+{
+    uint32_t messages{0};
+    uint32_t frames{0};
+    uint32_t falseDrops{0};
+    uint32_t duplicates{0};
+} result_t;
+
+typedef struct
+{
+    uint32_t position{0};
+    uint16_t sender{0};
+    uint32_t message{0};
+    uint16_t messageID{0};
+} frame_t;
+
+typedef struct
+{
+    const char *name;
+    uint16_t senders;
+    uint32_t messages;
+    uint8_t copies;
+    uint16_t firstID;  // 0 means random.
+    uint16_t restarts; // Number of sender restarts with a new random first message ID.
+    bool strict;
+} scenario_t;
+
+class OldDuplicateFilter
+{
+public:
+    bool isDuplicate(const uint16_t messageID)
+    {
+        for (uint8_t i{0}; i < sizeof(lastMessageID) / 2; ++i)
+            if (lastMessageID[i] == messageID)
+                return true;
+        for (uint8_t i{sizeof(lastMessageID) / 2 - 1}; i >= 1; --i)
+            lastMessageID[i] = lastMessageID[i - 1];
+        lastMessageID[0] = messageID;
+        return false;
+    }
+
+private:
+    uint16_t lastMessageID[10]{0};
+};
+
+ZHNetwork myNet;
+std::map<uint32_t, uint16_t> deliveries;
+
+void getSenderMAC(const uint16_t scenario, const uint16_t sender, uint8_t *mac)
+{
+    const uint8_t senderMAC[6]{0x02, 0xAA, (uint8_t)scenario, 0x00, (uint8_t)(sender >> 8), (uint8_t)sender};
+    memcpy(mac, senderMAC, 6);
+}
+
+std::vector<frame_t> generateFrames(const scenario_t &scenario)
+{
+    std::vector<frame_t> frames;
+    std::vector<uint16_t> sequence(scenario.senders);
+    for (uint16_t i{0}; i < scenario.senders; ++i)
+        sequence[i] = scenario.firstID ? scenario.firstID : random(0x10000);
+    uint32_t total = scenario.senders * scenario.messages;
+    for (uint32_t message{0}; message < total; ++message)
+    {
+        uint16_t sender = random(scenario.senders);
+        if (scenario.restarts && !random(total / scenario.restarts))
+            sequence[sender] = random(0x10000);
+        frame_t frame;
+        frame.sender = sender;
+        frame.message = message;
+        frame.messageID = sequence[sender]++;
+        for (uint8_t copy{0}; copy < scenario.copies; ++copy)
+        {
+            frame.position = message * 4 + (copy ? random(80) : 0); // Up to 20 frames later.
+            frames.push_back(frame);
+        }
+    }
+    std::stable_sort(frames.begin(), frames.end(), [](const frame_t &a, const frame_t &b)
+                     { return a.position < b.position; });
+    return frames;
+}
+
+result_t testNewFilter(const uint16_t index, const scenario_t &scenario, const std::vector<frame_t> &frames)
+{
+    result_t result;
+    deliveries.clear();
+    for (const frame_t &frame : frames)
+    {
+        transmitted_data_t transmittedData;
+        transmittedData.messageType = UNICAST;
+        transmittedData.messageID = frame.messageID;
+        strcpy(transmittedData.netName, "TEST");
+        memcpy(transmittedData.originalTargetMAC, host::mac, 6);
+        getSenderMAC(index, frame.sender, transmittedData.originalSenderMAC);
+        snprintf(transmittedData.message, sizeof(transmittedData.message), "%u", frame.message);
+        host::receive(transmittedData.originalSenderMAC, &transmittedData, sizeof(transmitted_data_t));
+        host::time += 1000;
+        myNet.maintenance();
+    }
+    result.frames = frames.size();
+    result.messages = scenario.senders * scenario.messages;
+    for (uint32_t message{0}; message < result.messages; ++message)
+    {
+        uint16_t count = deliveries.count(message) ? deliveries[message] : 0;
+        if (!count)
+            ++result.falseDrops;
+        else
+            result.duplicates += count - 1;
+    }
+    return result;
+}
+
+result_t testOldFilter(const scenario_t &scenario, std::vector<frame_t> frames)
+{
+    result_t result;
+    OldDuplicateFilter filter;
+    std::map<uint32_t, uint16_t> messageID;
+    for (frame_t &frame : frames)
+    {
+        if (!messageID.count(frame.message))
+            messageID[frame.message] = ((uint16_t)random(32767) << 8) | (uint16_t)random(32767);
+        frame.messageID = messageID[frame.message];
+    }
+    std::map<uint32_t, uint16_t> delivered;
+    for (const frame_t &frame : frames)
+        if (!filter.isDuplicate(frame.messageID))
+            ++delivered[frame.message];
+    result.frames = frames.size();
+    result.messages = scenario.senders * scenario.messages;
+    for (uint32_t message{0}; message < result.messages; ++message)
+    {
+        uint16_t count = delivered.count(message) ? delivered[message] : 0;
+        if (!count)
+            ++result.falseDrops;
+        else
+            result.duplicates += count - 1;
+    }
+    return result;
+}
+
+void printResult(const char *scheme, const result_t &result)
+{
+    printf("  %-4s messages %7u frames %7u false drops %6u (%.4f%%) duplicates delivered %6u\n", scheme, result.messages, result.frames,
+           result.falseDrops, 100.0 * result.falseDrops / result.messages, result.duplicates);
+}
+
+int main(int argc, char *argv[])
+{
+    randomSeed(argc > 1 ? strtoul(argv[1], nullptr, 0) : 1);
+    myNet.begin("TEST");
+    myNet.setOnUnicastReceivingCallback([](const char *data, const uint8_t *)
+                                        { ++deliveries[strtoul(data, nullptr, 10)]; });
+    const scenario_t scenarios[]{
+        {"5 senders, no copies", 5, 20000, 1, 0, 0, true},
+        {"10 senders, 3 copies out of order", 10, 10000, 3, 0, 0, true},
+        {"10 senders, 3 copies, message ID wraparound", 10, 200, 3, 0xFFF0, 0, true},
+        {"10 senders, 3 copies, 50 sender restarts", 10, 10000, 3, 0, 50, false},
+        {"30 senders (more than filter size), 3 copies", 30, 3000, 3, 0, 0, false},
+    };
+    bool passed{true};
+    for (uint16_t i{0}; i < sizeof(scenarios) / sizeof(scenario_t); ++i)
+    {
+        const scenario_t &scenario = scenarios[i];
+        std::vector<frame_t> frames = generateFrames(scenario);
+        printf("%s:\n", scenario.name);
+        printResult("old", testOldFilter(scenario, frames));
+        result_t result = testNewFilter(i + 1, scenario, frames);
+        printResult("new", result);
+        if (scenario.strict && scenario.senders <= ZHNETWORK_DUPLICATE_FILTER_SIZE && (result.falseDrops || result.duplicates))
+            passed = false;
+    }
+    printf("%s\n", passed ? "PASSED" : "FAILED");
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,86 @@
+// Minimal Arduino core for building ZHNetwork (ESP8266 variant) on a Linux host.
+// Time is virtual: it only moves when a test calls delay() or advances host::time.
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+#define IRAM_ATTR
+#define PROGMEM
+#define F(string) string
+#define pgm_read_byte(address) (*(const uint8_t *)(address))
+
+namespace host
+{
+    inline uint64_t time{0}; // Microseconds.
+    inline std::mt19937 generator;
+}
+
+inline unsigned long millis() { return host::time / 1000; }
+inline unsigned long micros() { return host::time; }
+inline void delay(const unsigned long ms) { host::time += ms * 1000; }
+inline void yield() {}
+inline void randomSeed(const unsigned long seed) { host::generator.seed(seed); }
+inline long random(const long max) { return max > 0 ? host::generator() % max : 0; }
+inline long random(const long min, const long max) { return max > min ? min + random(max - min) : min; }
+
+class String
+{
+public:
+    String() {}
+    String(const char *string) : string_(string) {}
+    String &operator+=(const char c)
+    {
+        string_ += c;
+        return *this;
+    }
+    bool operator==(const String &other) const { return string_ == other.string_; }
+    bool operator!=(const String &other) const { return string_ != other.string_; }
+    char charAt(const unsigned int index) const { return index < string_.size() ? string_[index] : 0; }
+    unsigned int length() const { return string_.size(); }
+    const char *c_str() const { return string_.c_str(); }
+
+private:
+    std::string string_;
+};
+
+class Print
+{
+public:
+    virtual ~Print() {}
+    virtual size_t write(const uint8_t byte) { return write(&byte, 1); }
+    virtual size_t write(const uint8_t *, const size_t length) { return length; }
+    void print(const char *string) { write((const uint8_t *)string, strlen(string)); }
+    void print(const String &string) { print(string.c_str()); }
+    void print(const unsigned long number) { print(std::to_string(number).c_str()); }
+    void println(const char *string = "")
+    {
+        print(string);
+        print("\n");
+    }
+    void println(const String &string) { println(string.c_str()); }
+    void println(const unsigned long number) { println(std::to_string(number).c_str()); }
+};
+
+class Stream : public Print
+{
+public:
+    virtual int available() { return 0; }
+    virtual int read() { return -1; }
+    virtual int availableForWrite() { return 0; }
+};
+
+class HardwareSerial : public Stream
+{
+public:
+    void begin(const unsigned long) {}
+    size_t write(const uint8_t *data, const size_t length) override { return fwrite(data, 1, length, stdout); }
+    int availableForWrite() override { return 4096; }
+};
+
+inline HardwareSerial Serial;
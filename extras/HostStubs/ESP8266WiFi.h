@@ -0,0 +1,58 @@
+// Minimal ESP8266 WiFi and system API for host builds. host::mac is returned as the node MAC.
+#pragma once
+
+#include "Arduino.h"
+
+enum WiFiMode_t
+{
+    WIFI_STA = 1,
+    WIFI_AP_STA = 3
+};
+
+enum
+{
+    STATION_IF,
+    SOFTAP_IF
+};
+
+namespace host
+{
+    inline uint8_t mac[6]{0x02, 0x00, 0x00, 0x00, 0x00, 0x01};
+    inline uint32_t rtcMemory[128]{0};
+}
+
+class ESP8266WiFiClass
+{
+public:
+    void mode(const WiFiMode_t) {}
+};
+
+class EspClass
+{
+public:
+    bool rtcUserMemoryRead(const uint32_t offset, uint32_t *data, const size_t size)
+    {
+        if (offset * 4 + size > sizeof(host::rtcMemory))
+            return false;
+        memcpy(data, &host::rtcMemory[offset], size);
+        return true;
+    }
+    bool rtcUserMemoryWrite(const uint32_t offset, uint32_t *data, const size_t size)
+    {
+        if (offset * 4 + size > sizeof(host::rtcMemory))
+            return false;
+        memcpy(&host::rtcMemory[offset], data, size);
+        return true;
+    }
+};
+
+inline ESP8266WiFiClass WiFi;
+inline EspClass ESP;
+
+inline uint32_t os_random() { return host::generator(); }
+
+inline bool wifi_get_macaddr(const uint8_t, uint8_t *mac)
+{
+    memcpy(mac, host::mac, 6);
+    return true;
+}
@@ -0,0 +1,57 @@
+// Minimal ESP8266 ESP-NOW API for host builds.
+// Sent frames are passed to host::onSend. Tests deliver frames and send results through host::receive() and host::sent().
+#pragma once
+
+#include "Arduino.h"
+
+enum esp_now_role
+{
+    ESP_NOW_ROLE_IDLE,
+    ESP_NOW_ROLE_CONTROLLER,
+    ESP_NOW_ROLE_SLAVE,
+    ESP_NOW_ROLE_COMBO
+};
+
+typedef void (*esp_now_send_cb_t)(uint8_t *mac, uint8_t status);
+typedef void (*esp_now_recv_cb_t)(uint8_t *mac, uint8_t *data, uint8_t length);
+
+namespace host
+{
+    inline esp_now_send_cb_t sendCallback{nullptr};
+    inline esp_now_recv_cb_t receiveCallback{nullptr};
+    inline std::function<void(const uint8_t *mac, const uint8_t *data, const uint8_t length)> onSend;
+
+    inline void receive(const uint8_t *mac, const void *data, const uint8_t length)
+    {
+        if (receiveCallback)
+            receiveCallback((uint8_t *)mac, (uint8_t *)data, length);
+    }
+
+    inline void sent(const uint8_t *mac, const bool success)
+    {
+        if (sendCallback)
+            sendCallback((uint8_t *)mac, success ? 0 : 1);
+    }
+}
+
+inline int esp_now_init() { return 0; }
+inline int esp_now_set_self_role(const uint8_t) { return 0; }
+
+inline int esp_now_register_send_cb(esp_now_send_cb_t callback)
+{
+    host::sendCallback = callback;
+    return 0;
+}
+
+inline int esp_now_register_recv_cb(esp_now_recv_cb_t callback)
+{
+    host::receiveCallback = callback;
+    return 0;
+}
+
+inline int esp_now_send(uint8_t *mac, uint8_t *data, const int length)
+{
+    if (host::onSend)
+        host::onSend(mac, data, length);
+    return 0;
+}
@@ -0,0 +1,169 @@
+// Simulation of flood collisions with random backoff and with slotted transmission (see setSlottedTransmission() in README.md).
+// Build: g++ -O2 -std=c++11 -o slot_simulation slot_simulation.cpp
+// Usage: slot_simulation [slot length, ms] [number of slots] [floods]
+//
+// All nodes are within radio range of each other. One node sends a broadcast, each node forwards the first received copy once.
+// Random backoff: forwarding after 0-9 ms (as forwarding delay of the library). Slotted: forwarding in own slot of the node
+// (FNV-1a hash of MAC as in the library, last 2 ms of slot are not used) with up to 0.5 ms clock error.
+// Without carrier sense (worst case, hidden nodes) any overlapping frames are lost. With carrier sense a node defers while
+// the channel is busy and only frames started within 20 µs of each other collide.
+// Flood duration is the time from the first transmission until the last forwarded copy.
+// Delivered ratio is the same as sum of floodFramesReceived / (sum of floodFramesSent * (nodes - 1)) of node statistics.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <queue>
+#include <random>
+#include <vector>
+
+const double airTime{1.9};      // ms, 250 byte ESP-NOW frame at 1 Mbps with preamble.
+const double senseTime{0.02};   // ms, frames started closer than this collide even with carrier sense.
+const double clockError{0.5};   // ms, max error of network time synchronization.
+const double forwardingMax{10}; // ms, forwarding delay is 0-9 ms.
+
+typedef struct
+{
+    double time;
+    bool start; // Start of transmission or end of transmission.
+    uint16_t node;
+    uint32_t transmission;
+} event_t;
+
+struct EventOrder
+{
+    bool operator()(const event_t &a, const event_t &b) const { return a.time > b.time; }
+};
+
+typedef struct
+{
+    uint32_t sent{0};
+    uint32_t collided{0};
+    uint64_t received{0};
+    uint64_t reached{0};
+    double duration{0};
+} result_t;
+
+static std::mt19937 generator(1);
+
+static double getRandom(const double max)
+{
+    return std::uniform_real_distribution<double>(0, max)(generator);
+}
+
+static uint32_t getChecksum(const uint8_t *data, const uint16_t length)
+{
+    uint32_t checksum{2166136261UL};
+    for (uint16_t i{0}; i < length; ++i)
+        checksum = (checksum ^ data[i]) * 16777619UL;
+    return checksum;
+}
+
+static double getSlotTime(const double ready, const uint32_t slotStart, const uint32_t slotLength, const uint32_t slotCount, const double error)
+{
+    double superframe = slotLength * slotCount;
+    double position = fmod(ready + error, superframe);
+    if (position >= slotStart && position + 2 < slotStart + slotLength)
+        return ready;
+    return ready + fmod(slotStart + superframe - position, superframe);
+}
+
+static result_t simulate(const uint16_t nodes, const bool slotted, const bool carrierSense, const uint32_t slotLength, const uint32_t slotCount, const uint32_t floods)
+{
+    result_t result;
+    std::vector<uint32_t> slotStart(nodes);
+    std::vector<double> error(nodes);
+    for (uint32_t flood{0}; flood < floods; ++flood)
+    {
+        double startTime = flood * 10000.0 + getRandom(1000); // Floods do not overlap.
+        for (uint16_t i{0}; i < nodes; ++i) // New MACs for each flood, so results are averaged over slot assignments.
+        {
+            const uint8_t mac[6]{0x24, 0x6F, 0x28, (uint8_t)generator(), (uint8_t)generator(), (uint8_t)generator()};
+            slotStart[i] = getChecksum(mac, 6) % slotCount * slotLength;
+            error[i] = getRandom(2 * clockError) - clockError;
+        }
+        std::priority_queue<event_t, std::vector<event_t>, EventOrder> events;
+        std::vector<bool> reached(nodes, false);
+        std::vector<bool> collided;
+        std::vector<uint32_t> active;
+        uint16_t origin = generator() % nodes;
+        reached[origin] = true;
+        events.push({slotted ? getSlotTime(startTime, slotStart[origin], slotLength, slotCount, error[origin]) : startTime, true, origin, 0});
+        double endTime{startTime};
+        std::vector<double> transmissionStart;
+        while (!events.empty())
+        {
+            event_t event = events.top();
+            events.pop();
+            if (event.start)
+            {
+                if (carrierSense && !active.empty() && event.time - transmissionStart[active.front()] >= senseTime)
+                {
+                    double busyUntil{0};
+                    for (uint32_t transmission : active)
+                        busyUntil = std::max(busyUntil, transmissionStart[transmission] + airTime);
+                    event.time = busyUntil + getRandom(0.3); // Random backoff after busy channel.
+                    events.push(event);
+                    continue;
+                }
+                uint32_t transmission = transmissionStart.size();
+                transmissionStart.push_back(event.time);
+                collided.push_back(!active.empty());
+                for (uint32_t other : active)
+                    collided[other] = true;
+                active.push_back(transmission);
+                events.push({event.time + airTime, false, event.node, transmission});
+                ++result.sent;
+                continue;
+            }
+            endTime = event.time;
+            for (uint32_t i{0}; i < active.size(); ++i)
+                if (active[i] == event.transmission)
+                    active.erase(active.begin() + i);
+            if (collided[event.transmission])
+            {
+                ++result.collided;
+                continue;
+            }
+            result.received += nodes - 1;
+            for (uint16_t i{0}; i < nodes; ++i)
+            {
+                if (reached[i])
+                    continue;
+                reached[i] = true;
+                double ready = event.time + (slotted ? 0 : getRandom(forwardingMax));
+                events.push({slotted ? getSlotTime(ready, slotStart[i], slotLength, slotCount, error[i]) : ready, true, i, 0});
+            }
+        }
+        for (uint16_t i{0}; i < nodes; ++i)
+            result.reached += reached[i];
+        result.duration += endTime - startTime;
+    }
+    return result;
+}
+
+int main(int argc, char *argv[])
+{
+    uint32_t slotLength = argc > 1 ? strtoul(argv[1], nullptr, 10) : 5;
+    uint32_t slotCount = argc > 2 ? strtoul(argv[2], nullptr, 10) : 50;
+    uint32_t floods = argc > 3 ? strtoul(argv[3], nullptr, 10) : 2000;
+    if (slotLength < 5 || slotLength > 100 || slotCount < 2 || slotCount > 100 || !floods)
+    {
+        fprintf(stderr, "Usage: %s [slot length 5-100 ms] [number of slots 2-100] [floods]\n", argv[0]);
+        return 1;
+    }
+    printf("%u floods, slot length %u ms, %u slots\n", floods, slotLength, slotCount);
+    printf("Carrier sense  Nodes  Mode     Collided  Delivered  Reached  Flood duration, ms\n");
+    for (bool carrierSense : {false, true})
+        for (uint16_t nodes : {5, 10, 20, 40})
+            for (bool slotted : {false, true})
+            {
+                result_t result = simulate(nodes, slotted, carrierSense, slotLength, slotCount, floods);
+                printf("%-13s  %5u  %-7s  %7.1f%%  %8.1f%%  %6.1f%%  %18.1f\n", carrierSense ? "yes" : "no", nodes, slotted ? "slotted" : "random",
+                       100.0 * result.collided / result.sent, 100.0 * result.received / ((double)result.sent * (nodes - 1)),
+                       100.0 * result.reached / ((double)floods * nodes), result.duration / floods);
+            }
+    return 0;
+}
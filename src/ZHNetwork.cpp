@@ -5,15 +5,28 @@ confirmation_vector_t ZHNetwork::confirmationVector;
 incoming_queue_t ZHNetwork::queueForIncomingData;
 outgoing_queue_t ZHNetwork::queueForOutgoingData;
 waiting_queue_t ZHNetwork::queueForRoutingVectorWaiting;
+tracking_vector_t ZHNetwork::trackingVector;
 
 bool ZHNetwork::criticalProcessSemaphore{false};
 bool ZHNetwork::sentMessageSemaphore{false};
 bool ZHNetwork::confirmReceivingSemaphore{false};
 bool ZHNetwork::confirmReceiving{false};
-char ZHNetwork::netName_[20]{0};
-char ZHNetwork::key_[20]{0};
+char ZHNetwork::netName_[21]{0};
+char ZHNetwork::key_[21]{0};
 uint8_t ZHNetwork::localMAC[6]{0};
-uint16_t ZHNetwork::lastMessageID[10]{0};
+duplicate_filter_t ZHNetwork::duplicateFilter[ZHNETWORK_DUPLICATE_FILTER_SIZE];
+uint16_t ZHNetwork::messageSequence{0};
+queue_limits_t ZHNetwork::queueLimits_;
+statistics_t ZHNetwork::statistics;
+#ifndef ZHNETWORK_NO_COMPRESSION
+static const char compressionDictionary[] PROGMEM = "{\"state\":\"ON\",\"OFF\",\"true,\"false,\"null,\"type\":\"\"id\":\"\"name\":\"\"mac\":\"\"value\":\"\"status\":\"\"mode\":\"\"power\":\"\"color\":\"\"brightness\":\"\"temperature\":\"\"humidity\":\"\"pressure\":\"\"battery\":\"\"voltage\":\"\"sensor\":\"\"switch\":\"\"light\":\"\"online\"}"; // Common JSON tokens used as preset history of compression.
+#endif
+#if defined(ESP32)
+RTC_NOINIT_ATTR uint32_t ZHNetwork::routingSnapshot[sizeof(routing_snapshot_t) / 4];
+TaskHandle_t ZHNetwork::maintenanceTaskHandle{nullptr};
+SemaphoreHandle_t ZHNetwork::maintenanceMutex{nullptr};
+portMUX_TYPE ZHNetwork::incomingQueueSpinlock = portMUX_INITIALIZER_UNLOCKED;
+#endif
 
 ZHNetwork &ZHNetwork::setOnBroadcastReceivingCallback(on_message_t onBroadcastReceivingCallback)
 {
@@ -27,6 +40,12 @@ ZHNetwork &ZHNetwork::setOnUnicastReceivingCallback(on_message_t onUnicastReceiv
     return *this;
 }
 
+ZHNetwork &ZHNetwork::setOnGroupReceivingCallback(on_group_message_t onGroupReceivingCallback)
+{
+    this->onGroupReceivingCallback = onGroupReceivingCallback;
+    return *this;
+}
+
 ZHNetwork &ZHNetwork::setOnConfirmReceivingCallback(on_confirm_t onConfirmReceivingCallback)
 {
     this->onConfirmReceivingCallback = onConfirmReceivingCallback;
@@ -41,6 +60,8 @@ error_code_t ZHNetwork::begin(const char *netName, const bool gateway)
 #if defined(ESP32)
     randomSeed(esp_random());
 #endif
+    messageSequence = random(0x10000);
+    gateway_ = gateway;
     if (strlen(netName) >= 1 && strlen(netName) <= 20)
         strcpy(netName_, netName);
 #ifdef PRINT_LOG
@@ -55,23 +76,163 @@ error_code_t ZHNetwork::begin(const char *netName, const bool gateway)
 #if defined(ESP32)
     esp_wifi_get_mac(gateway ? (wifi_interface_t)ESP_IF_WIFI_AP : (wifi_interface_t)ESP_IF_WIFI_STA, localMAC);
 #endif
+    if (routingPersistence_)
+        restoreRoutingState();
     esp_now_register_send_cb(onDataSent);
     esp_now_register_recv_cb(onDataReceive);
     return SUCCESS;
 }
 
-uint16_t ZHNetwork::sendBroadcastMessage(const char *data)
+uint16_t ZHNetwork::sendBroadcastMessage(const char *data, on_status_t onStatusCallback)
+{
+    if (strnlen(data, ZHNETWORK_MAX_MESSAGE_LENGTH) >= ZHNETWORK_MAX_MESSAGE_LENGTH)
+    {
+        lastSendError_ = SEND_MESSAGE_TOO_LONG;
+        return 0;
+    }
+    lock();
+    uint16_t messageID = broadcastMessage(data, broadcastMAC, BROADCAST);
+    lastSendError_ = messageID ? SEND_OK : SEND_QUEUE_FULL;
+    if (messageID)
+        trackMessage(messageID, BROADCAST, onStatusCallback);
+    unlock();
+    notifyMaintenanceTask();
+    return messageID;
+}
+
+uint16_t ZHNetwork::sendUnicastMessage(const char *data, const uint8_t *target, const bool confirm, on_status_t onStatusCallback)
+{
+#ifdef ZHNETWORK_NO_CONFIRM
+    if (confirm)
+    {
+        lastSendError_ = SEND_NOT_SUPPORTED;
+        return 0;
+    }
+#endif
+    if (strnlen(data, ZHNETWORK_MAX_MESSAGE_LENGTH) >= ZHNETWORK_MAX_MESSAGE_LENGTH)
+    {
+        lastSendError_ = SEND_MESSAGE_TOO_LONG;
+        return 0;
+    }
+    lock();
+    uint16_t messageID = unicastMessage(data, target, confirm ? UNICAST_WITH_CONFIRM : UNICAST);
+    lastSendError_ = messageID ? SEND_OK : SEND_QUEUE_FULL;
+    if (messageID)
+        trackMessage(messageID, confirm ? UNICAST_WITH_CONFIRM : UNICAST, onStatusCallback);
+    unlock();
+    notifyMaintenanceTask();
+    return messageID;
+}
+
+uint16_t ZHNetwork::sendGroupMessage(const char *data, const uint16_t group, on_status_t onStatusCallback)
+{
+    if (strnlen(data, ZHNETWORK_MAX_MESSAGE_LENGTH) >= ZHNETWORK_MAX_MESSAGE_LENGTH)
+    {
+        lastSendError_ = SEND_MESSAGE_TOO_LONG;
+        return 0;
+    }
+    outgoing_data_t outgoingData;
+    outgoingData.transmittedData.messageType = GROUP_MESSAGE;
+    memcpy(&outgoingData.transmittedData.netName, &netName_, sizeof(transmitted_data_t::netName));
+    memcpy(&outgoingData.transmittedData.originalTargetMAC, &groupMAC, 6);
+    outgoingData.transmittedData.originalTargetMAC[4] = group >> 8;
+    outgoingData.transmittedData.originalTargetMAC[5] = group & 0xFF;
+    memcpy(&outgoingData.transmittedData.originalSenderMAC, &localMAC, 6);
+    packMessage(outgoingData.transmittedData, data);
+    lock();
+    outgoingData.transmittedData.messageID = getNextMessageID();
+    uint16_t messageID{0};
+    uint8_t numberOfCopies = multicastMessage(outgoingData.transmittedData, localMAC);
+    if (numberOfCopies || queueForOutgoingData.size() < queueLimits_.outgoing)
+    {
+        messageID = outgoingData.transmittedData.messageID;
+        trackMessage(messageID, GROUP_MESSAGE, onStatusCallback);
+        if (!numberOfCopies)
+            updateMessageStatus(messageID, MESSAGE_SENT);
+    }
+    lastSendError_ = messageID ? SEND_OK : SEND_QUEUE_FULL;
+    unlock();
+    notifyMaintenanceTask();
+    return messageID;
+}
+
+error_code_t ZHNetwork::joinGroup(const uint16_t group)
+{
+    lock();
+    error_code_t code{SUCCESS};
+    if (!isGroupMember(group))
+    {
+        if (groupVector.size() < 10)
+        {
+            groupVector.push_back(group);
+            groupJoinPending = true;
+            groupJoinDelay = 0;
+        }
+        else
+            code = ERROR;
+    }
+    unlock();
+    return code;
+}
+
+error_code_t ZHNetwork::leaveGroup(const uint16_t group)
+{
+    lock();
+    for (uint8_t i{0}; i < groupVector.size(); ++i)
+        if (groupVector[i] == group)
+            groupVector.erase(groupVector.begin() + i);
+    unlock();
+    return SUCCESS;
+}
+
+message_status_t ZHNetwork::getMessageStatus(const uint16_t messageID)
 {
-    return broadcastMessage(data, broadcastMAC, BROADCAST);
+    message_status_t status{MESSAGE_UNKNOWN};
+    lock();
+    for (uint16_t i{0}; i < trackingVector.size(); ++i)
+        if (trackingVector[i].messageID == messageID)
+            status = trackingVector[i].status;
+    unlock();
+    return status;
 }
 
-uint16_t ZHNetwork::sendUnicastMessage(const char *data, const uint8_t *target, const bool confirm)
+send_error_t ZHNetwork::getLastSendError()
 {
-    return unicastMessage(data, target, localMAC, confirm ? UNICAST_WITH_CONFIRM : UNICAST);
+    return lastSendError_;
 }
 
 void ZHNetwork::maintenance()
 {
+    lock();
+    uint32_t startTime = micros();
+    if (routingPersistence_ && (millis() - lastRoutingSnapshotTime) > 1000)
+    {
+        saveRoutingState();
+        lastRoutingSnapshotTime = millis();
+    }
+    if (gateway_ && (!lastGatewayBeaconTime || (millis() - lastGatewayBeaconTime) > gatewayBeaconInterval_ * 1000UL))
+    {
+        gateway_beacon_t beacon;
+        beacon.interval = gatewayBeaconInterval_;
+        beacon.slotCount = slotCount_;
+        beacon.slotLength = slotLength_;
+        char temp[sizeof(transmitted_data_t::message)];
+        memcpy(&temp, &beacon, sizeof(transmitted_data_t::message));
+        broadcastMessage(temp, broadcastMAC, GATEWAY_BEACON);
+        lastGatewayBeaconTime = millis();
+    }
+    if (groupJoinPending && (millis() - lastGroupJoinTime) >= groupJoinDelay && isParentAvailable())
+    {
+        groupJoinPending = false;
+        for (uint8_t i{0}; i < groupVector.size(); ++i)
+        {
+            group_id_t id;
+            id.group = groupVector[i];
+            char temp[sizeof(transmitted_data_t::message)];
+            memcpy(&temp, &id, sizeof(transmitted_data_t::message));
+            unicastMessage(temp, gatewayMAC, GROUP_JOIN);
+        }
+    }
     if (sentMessageSemaphore && confirmReceivingSemaphore)
     {
         sentMessageSemaphore = false;
@@ -81,13 +242,19 @@ void ZHNetwork::maintenance()
 #ifdef PRINT_LOG
             Serial.println(F("OK."));
 #endif
+            ++statistics.sentFrames;
+            if (adaptiveRateControl_)
+                transmissionInterval = transmissionInterval > maxWaitingTimeBetweenTransmissions_ + 10 ? transmissionInterval - 10 : maxWaitingTimeBetweenTransmissions_;
             outgoing_data_t outgoingData = queueForOutgoingData.front();
-            queueForOutgoingData.pop();
+            queueForOutgoingData.pop_front();
 #if defined(ESP32)
             esp_now_del_peer(outgoingData.intermediateTargetMAC);
 #endif
+            if (macToString(outgoingData.transmittedData.originalSenderMAC) == macToString(localMAC))
+                updateMessageStatus(outgoingData.transmittedData.messageID, MESSAGE_SENT);
             if (onConfirmReceivingCallback && macToString(outgoingData.transmittedData.originalSenderMAC) == macToString(localMAC) && outgoingData.transmittedData.messageType == BROADCAST)
                 onConfirmReceivingCallback(outgoingData.transmittedData.originalTargetMAC, outgoingData.transmittedData.messageID, true);
+#ifndef ZHNETWORK_NO_CONFIRM
             if (macToString(outgoingData.transmittedData.originalSenderMAC) == macToString(localMAC) && outgoingData.transmittedData.messageType == UNICAST_WITH_CONFIRM)
             {
                 confirmation_waiting_data_t confirmationData;
@@ -96,47 +263,104 @@ void ZHNetwork::maintenance()
                 memcpy(&confirmationData.messageID, &outgoingData.transmittedData.messageID, 2);
                 confirmationVector.push_back(confirmationData);
             }
+#endif
         }
         else
         {
 #ifdef PRINT_LOG
             Serial.println(F("FAULT."));
 #endif
+            ++statistics.failedTransmissions;
+            if (adaptiveRateControl_)
+                transmissionInterval = transmissionInterval * 2 > 1000 ? 1000 : transmissionInterval * 2;
             if (numberOfAttemptsToSend < maxNumberOfAttempts_)
                 ++numberOfAttemptsToSend;
             else
             {
                 outgoing_data_t outgoingData = queueForOutgoingData.front();
-                queueForOutgoingData.pop();
+                queueForOutgoingData.pop_front();
 #if defined(ESP32)
                 esp_now_del_peer(outgoingData.intermediateTargetMAC);
 #endif
                 numberOfAttemptsToSend = 1;
-                for (uint16_t i{0}; i < routingVector.size(); ++i)
+                if (gatewayHops && macToString(outgoingData.intermediateTargetMAC) == macToString(parentMAC) && (outgoingData.transmittedData.messageType == GROUP_MESSAGE || macToString(outgoingData.transmittedData.originalTargetMAC) == macToString(gatewayMAC)))
+                {
+                    gatewayHops = 0;
+#ifdef PRINT_LOG
+                    Serial.print(F("CHECKING ROUTING TABLE... Parent MAC "));
+                    Serial.print(macToString(parentMAC));
+                    Serial.println(F(" lost."));
+#endif
+                }
+                if (outgoingData.transmittedData.messageType == GROUP_MESSAGE)
+                {
+                    for (uint16_t i{0}; i < groupRoutingVector.size();)
+                        if (macToString(groupRoutingVector[i].nextHopMAC) == macToString(outgoingData.intermediateTargetMAC))
+                            groupRoutingVector.erase(groupRoutingVector.begin() + i);
+                        else
+                            ++i;
+#ifdef PRINT_LOG
+                    Serial.print(F("CHECKING GROUP TABLE... Routing via MAC "));
+                    Serial.print(macToString(outgoingData.intermediateTargetMAC));
+                    Serial.println(F(" deleted."));
+#endif
+                    if (macToString(outgoingData.transmittedData.originalSenderMAC) == macToString(localMAC))
+                    {
+                        bool copyQueued{false}; // Other copies of the message may still be sent.
+                        for (uint16_t i{0}; i < queueForOutgoingData.size(); ++i)
+                            if (queueForOutgoingData[i].transmittedData.messageID == outgoingData.transmittedData.messageID && macToString(queueForOutgoingData[i].transmittedData.originalSenderMAC) == macToString(localMAC))
+                                copyQueued = true;
+                        if (!copyQueued && getMessageStatus(outgoingData.transmittedData.messageID) == MESSAGE_QUEUED)
+                            updateMessageStatus(outgoingData.transmittedData.messageID, MESSAGE_FAILED_NO_ROUTE);
+                    }
+                }
+                else
                 {
-                    routing_table_t routingTable = routingVector[i];
-                    if (macToString(routingTable.originalTargetMAC) == macToString(outgoingData.transmittedData.originalTargetMAC))
+                    for (uint16_t i{0}; i < routingVector.size(); ++i)
                     {
-                        routingVector.erase(routingVector.begin() + i);
+                        routing_table_t routingTable = routingVector[i];
+                        if (macToString(routingTable.originalTargetMAC) == macToString(outgoingData.transmittedData.originalTargetMAC))
+                        {
+                            routingVector.erase(routingVector.begin() + i);
 #ifdef PRINT_LOG
-                        Serial.print(F("CHECKING ROUTING TABLE... Routing to MAC "));
-                        Serial.print(macToString(outgoingData.transmittedData.originalTargetMAC));
-                        Serial.println(F(" deleted."));
+                            Serial.print(F("CHECKING ROUTING TABLE... Routing to MAC "));
+                            Serial.print(macToString(outgoingData.transmittedData.originalTargetMAC));
+                            Serial.println(F(" deleted."));
 #endif
+                        }
                     }
+                    waiting_data_t waitingData;
+                    waitingData.time = millis();
+                    memcpy(&waitingData.intermediateTargetMAC, &outgoingData.intermediateTargetMAC, 6);
+                    memcpy(&waitingData.transmittedData, &outgoingData.transmittedData, sizeof(transmitted_data_t));
+                    if (!pushWaitingData(waitingData))
+                        dropMessage(waitingData.transmittedData);
+                    broadcastMessage("", outgoingData.transmittedData.originalTargetMAC, SEARCH_REQUEST);
                 }
-                waiting_data_t waitingData;
-                waitingData.time = millis();
-                memcpy(&waitingData.intermediateTargetMAC, &outgoingData.intermediateTargetMAC, 6);
-                memcpy(&waitingData.transmittedData, &outgoingData.transmittedData, sizeof(transmitted_data_t));
-                queueForRoutingVectorWaiting.push(waitingData);
-                broadcastMessage("", outgoingData.transmittedData.originalTargetMAC, SEARCH_REQUEST);
             }
         }
     }
-    if (!queueForOutgoingData.empty() && ((millis() - lastMessageSentTime) > maxWaitingTimeBetweenTransmissions_))
+    bool slotted = slotCount_ && isTimeSynchronized();
+    bool transmissionAllowed = ((millis() - lastMessageSentTime) > transmissionInterval) && ((millis() - lastForwardingTime) >= forwardingDelay);
+    if (slotted)
+    {
+        uint16_t backoff = transmissionInterval > maxWaitingTimeBetweenTransmissions_ ? transmissionInterval - maxWaitingTimeBetweenTransmissions_ : 0; // Added by adaptive rate control after failed transmissions.
+        transmissionAllowed = !getTimeToSlot() && (millis() - lastMessageSentTime) >= backoff && (!sentMessageSemaphore || (millis() - lastMessageSentTime) > transmissionInterval);
+    }
+    if (!queueForOutgoingData.empty() && transmissionAllowed)
     {
         outgoing_data_t outgoingData = queueForOutgoingData.front();
+        if (outgoingData.transmittedData.messageType == GATEWAY_BEACON && macToString(outgoingData.transmittedData.originalSenderMAC) == macToString(gateway_ ? localMAC : gatewayMAC) && isTimeSynchronized())
+        {
+            gateway_beacon_t beacon;
+            memcpy((void *)&beacon, &outgoingData.transmittedData.message, sizeof(transmitted_data_t::message));
+            beacon.time = getNetworkTime();
+            memcpy(&outgoingData.transmittedData.message, &beacon, sizeof(transmitted_data_t::message));
+        }
+        if (slotted)
+            ++statistics.slottedTransmissions;
+        if (isFloodMessage(outgoingData.transmittedData.messageType))
+            ++statistics.floodFramesSent;
 #if defined(ESP32)
         esp_now_peer_info_t peerInfo;
         memset(&peerInfo, 0, sizeof(peerInfo));
@@ -169,6 +393,15 @@ void ZHNetwork::maintenance()
         case SEARCH_RESPONSE:
             Serial.print(F("SEARCH_RESPONSE"));
             break;
+        case GATEWAY_BEACON:
+            Serial.print(F("GATEWAY_BEACON"));
+            break;
+        case GROUP_JOIN:
+            Serial.print(F("GROUP_JOIN"));
+            break;
+        case GROUP_MESSAGE:
+            Serial.print(F("GROUP_MESSAGE"));
+            break;
         default:
             break;
         }
@@ -181,13 +414,15 @@ void ZHNetwork::maintenance()
         Serial.print(F(" sended. Status "));
 #endif
     }
-    if (!queueForIncomingData.empty())
+    size_t outgoingQueueSize = queueForOutgoingData.size();
+    for (uint8_t n{0}; n < maintenanceBudget_.incoming && (queueForOutgoingData.size() - outgoingQueueSize) < maintenanceBudget_.forwarding && !isTimeSliceExceeded(startTime); ++n)
     {
-        criticalProcessSemaphore = true;
-        incoming_data_t incomingData = queueForIncomingData.front();
-        queueForIncomingData.pop();
-        criticalProcessSemaphore = false;
+        incoming_data_t incomingData;
+        if (!popIncomingData(incomingData))
+            break;
         bool forward{false};
+        bool relay{false};
+        bool multicast{false};
         bool routingUpdate{false};
         switch (incomingData.transmittedData.messageType)
         {
@@ -197,12 +432,16 @@ void ZHNetwork::maintenance()
             Serial.print(macToString(incomingData.transmittedData.originalSenderMAC));
             Serial.println(F(" received."));
 #endif
-            if (onBroadcastReceivingCallback)
+            if (onBroadcastReceivingCallback || bridgeStream)
             {
-                if (key_[0])
-                    for (uint8_t i{0}; i < strlen(incomingData.transmittedData.message); ++i)
-                        incomingData.transmittedData.message[i] = incomingData.transmittedData.message[i] ^ key_[i % strlen(key_)];
-                onBroadcastReceivingCallback(incomingData.transmittedData.message, incomingData.transmittedData.originalSenderMAC);
+                transmitted_data_t transmittedData;
+                memcpy(&transmittedData, &incomingData.transmittedData, sizeof(transmitted_data_t));
+                if (unpackMessage(transmittedData))
+                {
+                    bridgeMessage(transmittedData, 0);
+                    if (onBroadcastReceivingCallback)
+                        onBroadcastReceivingCallback(transmittedData.message, transmittedData.originalSenderMAC);
+                }
             }
             forward = true;
             break;
@@ -216,18 +455,19 @@ void ZHNetwork::maintenance()
             Serial.print(macToString(incomingData.intermediateSenderMAC));
             Serial.println(F(" received."));
 #endif
+            if (macToString(incomingData.transmittedData.originalTargetMAC) == macToString(gateway_ ? localMAC : gatewayMAC))
+                routingUpdate = true;
             if (macToString(incomingData.transmittedData.originalTargetMAC) == macToString(localMAC))
             {
-                if (onUnicastReceivingCallback)
+                if ((onUnicastReceivingCallback || bridgeStream) && unpackMessage(incomingData.transmittedData))
                 {
-                    if (key_[0])
-                        for (uint8_t i{0}; i < strlen(incomingData.transmittedData.message); ++i)
-                            incomingData.transmittedData.message[i] = incomingData.transmittedData.message[i] ^ key_[i % strlen(key_)];
-                    onUnicastReceivingCallback(incomingData.transmittedData.message, incomingData.transmittedData.originalSenderMAC);
+                    bridgeMessage(incomingData.transmittedData, 0);
+                    if (onUnicastReceivingCallback)
+                        onUnicastReceivingCallback(incomingData.transmittedData.message, incomingData.transmittedData.originalSenderMAC);
                 }
             }
             else
-                unicastMessage(incomingData.transmittedData.message, incomingData.transmittedData.originalTargetMAC, incomingData.transmittedData.originalSenderMAC, UNICAST);
+                relay = true;
             break;
         case UNICAST_WITH_CONFIRM:
 #ifdef PRINT_LOG
@@ -239,23 +479,24 @@ void ZHNetwork::maintenance()
             Serial.print(macToString(incomingData.intermediateSenderMAC));
             Serial.println(F(" received."));
 #endif
+            if (macToString(incomingData.transmittedData.originalTargetMAC) == macToString(gateway_ ? localMAC : gatewayMAC))
+                routingUpdate = true;
             if (macToString(incomingData.transmittedData.originalTargetMAC) == macToString(localMAC))
             {
-                if (onUnicastReceivingCallback)
+                if ((onUnicastReceivingCallback || bridgeStream) && unpackMessage(incomingData.transmittedData))
                 {
-                    if (key_[0])
-                        for (uint8_t i{0}; i < strlen(incomingData.transmittedData.message); ++i)
-                            incomingData.transmittedData.message[i] = incomingData.transmittedData.message[i] ^ key_[i % strlen(key_)];
-                    onUnicastReceivingCallback(incomingData.transmittedData.message, incomingData.transmittedData.originalSenderMAC);
+                    bridgeMessage(incomingData.transmittedData, 0);
+                    if (onUnicastReceivingCallback)
+                        onUnicastReceivingCallback(incomingData.transmittedData.message, incomingData.transmittedData.originalSenderMAC);
                 }
                 confirmation_id_t id;
                 memcpy(&id.messageID, &incomingData.transmittedData.messageID, 2);
                 char temp[sizeof(transmitted_data_t::message)];
                 memcpy(&temp, &id, sizeof(transmitted_data_t::message));
-                unicastMessage(temp, incomingData.transmittedData.originalSenderMAC, localMAC, DELIVERY_CONFIRM_RESPONSE);
+                unicastMessage(temp, incomingData.transmittedData.originalSenderMAC, DELIVERY_CONFIRM_RESPONSE);
             }
             else
-                unicastMessage(incomingData.transmittedData.message, incomingData.transmittedData.originalTargetMAC, incomingData.transmittedData.originalSenderMAC, UNICAST_WITH_CONFIRM);
+                relay = true;
             break;
         case DELIVERY_CONFIRM_RESPONSE:
 #ifdef PRINT_LOG
@@ -269,21 +510,23 @@ void ZHNetwork::maintenance()
 #endif
             if (macToString(incomingData.transmittedData.originalTargetMAC) == macToString(localMAC))
             {
-                if (onConfirmReceivingCallback)
+                confirmation_id_t id;
+                memcpy(&id.messageID, &incomingData.transmittedData.message, 2);
+                for (uint16_t i{0}; i < confirmationVector.size(); ++i)
                 {
-                    confirmation_id_t id;
-                    memcpy(&id.messageID, &incomingData.transmittedData.message, 2);
-                    for (uint16_t i{0}; i < confirmationVector.size(); ++i)
+                    confirmation_waiting_data_t confirmationData = confirmationVector[i];
+                    if (confirmationData.messageID == id.messageID)
                     {
-                        confirmation_waiting_data_t confirmationData = confirmationVector[i];
-                        if (confirmationData.messageID == id.messageID)
-                            confirmationVector.erase(confirmationVector.begin() + i);
+                        confirmationVector.erase(confirmationVector.begin() + i);
+                        break;
                     }
-                    onConfirmReceivingCallback(incomingData.transmittedData.originalSenderMAC, id.messageID, true);
                 }
+                updateMessageStatus(id.messageID, MESSAGE_DELIVERED);
+                if (onConfirmReceivingCallback)
+                    onConfirmReceivingCallback(incomingData.transmittedData.originalSenderMAC, id.messageID, true);
             }
             else
-                unicastMessage(incomingData.transmittedData.message, incomingData.transmittedData.originalTargetMAC, incomingData.transmittedData.originalSenderMAC, DELIVERY_CONFIRM_RESPONSE);
+                relay = true;
             break;
         case SEARCH_REQUEST:
 #ifdef PRINT_LOG
@@ -311,17 +554,149 @@ void ZHNetwork::maintenance()
                 forward = true;
             routingUpdate = true;
             break;
+        case GATEWAY_BEACON:
+        {
+#ifdef PRINT_LOG
+            Serial.print(F("GATEWAY_BEACON message from MAC "));
+            Serial.print(macToString(incomingData.transmittedData.originalSenderMAC));
+            Serial.print(F(" via MAC "));
+            Serial.print(macToString(incomingData.intermediateSenderMAC));
+            Serial.println(F(" received."));
+#endif
+            gateway_beacon_t beacon;
+            memcpy((void *)&beacon, &incomingData.transmittedData.message, sizeof(transmitted_data_t::message));
+            ++beacon.hops;
+            if (beacon.interval < 10 || beacon.interval > 3600)
+                break; // Beacons are not crypted. Malformed beacon is neither used nor forwarded.
+            if (!gateway_ && (!isParentAvailable() || macToString(incomingData.transmittedData.originalSenderMAC) == macToString(gatewayMAC) || beacon.hops < gatewayHops))
+            {
+                memcpy(&gatewayMAC, &incomingData.transmittedData.originalSenderMAC, 6);
+                memcpy(&parentMAC, &incomingData.intermediateSenderMAC, 6);
+                gatewayHops = beacon.hops;
+                gatewayBeaconInterval_ = beacon.interval;
+                lastGatewayBeaconTime = millis();
+                bool slotsValid = beacon.slotCount >= 2 && beacon.slotCount <= 100 && beacon.slotLength >= 5 && beacon.slotLength <= 100;
+                slotCount_ = slotsValid ? beacon.slotCount : 0; // Invalid slot settings disable slotted transmission.
+                slotLength_ = slotsValid ? beacon.slotLength : 0;
+                networkTimeOffset = beacon.time - incomingData.time; // Reception time, beacon may wait in incoming queue.
+                timeSynchronized = beacon.time;
+                if (!groupVector.empty())
+                {
+                    groupJoinPending = true;
+                    lastGroupJoinTime = millis();
+                    groupJoinDelay = random(gatewayBeaconInterval_ * 500UL);
+                }
+#ifdef PRINT_LOG
+                Serial.print(F("CHECKING ROUTING TABLE... Routing to gateway MAC "));
+                Serial.print(macToString(gatewayMAC));
+                Serial.print(F(" updated. Parent is "));
+                Serial.print(macToString(parentMAC));
+                Serial.print(F(", hops "));
+                Serial.print(gatewayHops);
+                Serial.println(F("."));
+#endif
+            }
+            memcpy(&incomingData.transmittedData.message, &beacon, sizeof(transmitted_data_t::message));
+            forward = true;
+            break;
+        }
+        case GROUP_JOIN:
+        {
+#ifdef PRINT_LOG
+            Serial.print(F("GROUP_JOIN message from MAC "));
+            Serial.print(macToString(incomingData.transmittedData.originalSenderMAC));
+            Serial.print(F(" to MAC "));
+            Serial.print(macToString(incomingData.transmittedData.originalTargetMAC));
+            Serial.print(F(" via MAC "));
+            Serial.print(macToString(incomingData.intermediateSenderMAC));
+            Serial.println(F(" received."));
+#endif
+#ifndef ZHNETWORK_LEAF_NODE
+            group_id_t id;
+            memcpy(&id.group, &incomingData.transmittedData.message, 2);
+            bool groupRouteFound{false};
+            for (uint16_t i{0}; i < groupRoutingVector.size(); ++i)
+                if (groupRoutingVector[i].group == id.group && macToString(groupRoutingVector[i].nextHopMAC) == macToString(incomingData.intermediateSenderMAC))
+                {
+                    groupRoutingVector[i].time = millis();
+                    groupRouteFound = true;
+                }
+            if (!groupRouteFound)
+            {
+                group_routing_t groupRouting;
+                groupRouting.group = id.group;
+                groupRouting.time = millis();
+                memcpy(&groupRouting.nextHopMAC, &incomingData.intermediateSenderMAC, 6);
+                if (groupRoutingVector.size() >= ZHNETWORK_ROUTING_TABLE_SIZE)
+                    groupRoutingVector.erase(groupRoutingVector.begin());
+                groupRoutingVector.push_back(groupRouting);
+#ifdef PRINT_LOG
+                Serial.print(F("CHECKING GROUP TABLE... Routing for group "));
+                Serial.print(id.group);
+                Serial.print(F(" added. Target is "));
+                Serial.print(macToString(incomingData.intermediateSenderMAC));
+                Serial.println(F("."));
+#endif
+            }
+#endif
+            if (macToString(incomingData.transmittedData.originalTargetMAC) == macToString(gateway_ ? localMAC : gatewayMAC))
+                routingUpdate = true;
+            if (macToString(incomingData.transmittedData.originalTargetMAC) != macToString(localMAC))
+                relay = true;
+            break;
+        }
+        case GROUP_MESSAGE:
+        {
+            uint16_t group = macToGroup(incomingData.transmittedData.originalTargetMAC);
+#ifdef PRINT_LOG
+            Serial.print(F("GROUP_MESSAGE message from MAC "));
+            Serial.print(macToString(incomingData.transmittedData.originalSenderMAC));
+            Serial.print(F(" to group "));
+            Serial.print(group);
+            Serial.print(F(" via MAC "));
+            Serial.print(macToString(incomingData.intermediateSenderMAC));
+            Serial.println(F(" received."));
+#endif
+            multicast = true;
+            if ((!onGroupReceivingCallback && !bridgeStream) || !isGroupMember(group))
+                break;
+            transmitted_data_t transmittedData;
+            memcpy(&transmittedData, &incomingData.transmittedData, sizeof(transmitted_data_t));
+            if (!unpackMessage(transmittedData))
+                break;
+            bridgeMessage(transmittedData, group);
+            if (onGroupReceivingCallback)
+                onGroupReceivingCallback(transmittedData.message, transmittedData.originalSenderMAC, group);
+            break;
+        }
         default:
             break;
         }
+#ifndef ZHNETWORK_LEAF_NODE
         if (forward)
         {
             outgoing_data_t outgoingData;
             memcpy(&outgoingData.transmittedData, &incomingData.transmittedData, sizeof(transmitted_data_t));
             memcpy(&outgoingData.intermediateTargetMAC, &broadcastMAC, 6);
-            queueForOutgoingData.push(outgoingData);
-            delay(random(10));
+            if (pushOutgoingData(outgoingData))
+            {
+                lastForwardingTime = millis();
+                forwardingDelay = random(10);
+            }
+        }
+        if (relay)
+        {
+            outgoing_data_t outgoingData;
+            memcpy(&outgoingData.transmittedData, &incomingData.transmittedData, sizeof(transmitted_data_t));
+            routeMessage(outgoingData);
         }
+        if (multicast)
+            multicastMessage(incomingData.transmittedData, incomingData.intermediateSenderMAC);
+#else
+        (void)forward; // Leaf node never forwards messages of other nodes and does not keep group routes.
+        (void)relay;
+        (void)multicast;
+#endif
         if (routingUpdate)
         {
             bool routeFound{false};
@@ -334,7 +709,6 @@ void ZHNetwork::maintenance()
                     if (macToString(routingTable.intermediateTargetMAC) != macToString(incomingData.intermediateSenderMAC))
                     {
                         memcpy(&routingTable.intermediateTargetMAC, &incomingData.intermediateSenderMAC, 6);
-                        routingVector.at(i) = routingTable;
 #ifdef PRINT_LOG
                         Serial.print(F("CHECKING ROUTING TABLE... Routing to MAC "));
                         Serial.print(macToString(incomingData.transmittedData.originalSenderMAC));
@@ -343,6 +717,9 @@ void ZHNetwork::maintenance()
                         Serial.println(F("."));
 #endif
                     }
+                    routingVector.erase(routingVector.begin() + i);
+                    routingVector.push_back(routingTable); // The least recently used route is replaced if the table is full.
+                    break;
                 }
             }
             if (!routeFound)
@@ -352,6 +729,12 @@ void ZHNetwork::maintenance()
                     routing_table_t routingTable;
                     memcpy(&routingTable.originalTargetMAC, &incomingData.transmittedData.originalSenderMAC, 6);
                     memcpy(&routingTable.intermediateTargetMAC, &incomingData.intermediateSenderMAC, 6);
+#ifndef ZHNETWORK_LEAF_NODE
+                    while (routingVector.size() >= (gateway_ ? ZHNETWORK_GATEWAY_ROUTING_TABLE_SIZE : ZHNETWORK_ROUTING_TABLE_SIZE))
+#else
+                    while (routingVector.size() >= ZHNETWORK_ROUTING_TABLE_SIZE)
+#endif
+                        routingVector.erase(routingVector.begin());
                     routingVector.push_back(routingTable);
 #ifdef PRINT_LOG
                     Serial.print(F("CHECKING ROUTING TABLE... Routing to MAC "));
@@ -364,32 +747,26 @@ void ZHNetwork::maintenance()
             }
         }
     }
-    if (!queueForRoutingVectorWaiting.empty())
+    for (uint16_t n{0}, size = queueForRoutingVectorWaiting.size(); n < maintenanceBudget_.routingWaiting && n < size && !isTimeSliceExceeded(startTime); ++n)
     {
         waiting_data_t waitingData = queueForRoutingVectorWaiting.front();
-        for (uint16_t i{0}; i < routingVector.size(); ++i)
+        queueForRoutingVectorWaiting.pop_front();
+        outgoing_data_t outgoingData;
+        if (queueForOutgoingData.size() < queueLimits_.outgoing && findRoute(waitingData.transmittedData.originalTargetMAC, outgoingData.intermediateTargetMAC))
         {
-            routing_table_t routingTable = routingVector[i];
-            if (macToString(routingTable.originalTargetMAC) == macToString(waitingData.transmittedData.originalTargetMAC))
-            {
-                queueForRoutingVectorWaiting.pop();
-                outgoing_data_t outgoingData;
-                memcpy(&outgoingData.transmittedData, &waitingData.transmittedData, sizeof(transmitted_data_t));
-                memcpy(&outgoingData.intermediateTargetMAC, &routingTable.intermediateTargetMAC, 6);
-                queueForOutgoingData.push(outgoingData);
+            memcpy(&outgoingData.transmittedData, &waitingData.transmittedData, sizeof(transmitted_data_t));
+            queueForOutgoingData.push_back(outgoingData);
 #ifdef PRINT_LOG
-                Serial.print(F("CHECKING ROUTING TABLE... Routing to MAC "));
-                Serial.print(macToString(outgoingData.transmittedData.originalTargetMAC));
-                Serial.print(F(" found. Target is "));
-                Serial.print(macToString(outgoingData.intermediateTargetMAC));
-                Serial.println(F("."));
+            Serial.print(F("CHECKING ROUTING TABLE... Routing to MAC "));
+            Serial.print(macToString(outgoingData.transmittedData.originalTargetMAC));
+            Serial.print(F(" found. Target is "));
+            Serial.print(macToString(outgoingData.intermediateTargetMAC));
+            Serial.println(F("."));
 #endif
-                return;
-            }
+            continue;
         }
         if ((millis() - waitingData.time) > maxTimeForRoutingInfoWaiting_)
         {
-            queueForRoutingVectorWaiting.pop();
 #ifdef PRINT_LOG
             Serial.print(F("CHECKING ROUTING TABLE... Routing to MAC "));
             Serial.print(macToString(waitingData.transmittedData.originalTargetMAC));
@@ -416,32 +793,66 @@ void ZHNetwork::maintenance()
             Serial.print(macToString(waitingData.intermediateTargetMAC));
             Serial.println(F(" undelivered."));
 #endif
+            if (macToString(waitingData.transmittedData.originalSenderMAC) == macToString(localMAC))
+                updateMessageStatus(waitingData.transmittedData.messageID, MESSAGE_FAILED_NO_ROUTE);
             if (waitingData.transmittedData.messageType == UNICAST_WITH_CONFIRM && macToString(waitingData.transmittedData.originalSenderMAC) == macToString(localMAC))
                 if (onConfirmReceivingCallback)
                     onConfirmReceivingCallback(waitingData.transmittedData.originalTargetMAC, waitingData.transmittedData.messageID, false);
         }
+        else
+            queueForRoutingVectorWaiting.push_back(waitingData);
     }
-    if (confirmationVector.size())
+#ifndef ZHNETWORK_NO_CONFIRM
+    for (uint16_t i{0}, n{0}; i < confirmationVector.size() && n < maintenanceBudget_.confirmation && !isTimeSliceExceeded(startTime);)
     {
-        for (uint16_t i{0}; i < confirmationVector.size(); ++i)
+        confirmation_waiting_data_t confirmationData = confirmationVector[i];
+        if ((millis() - confirmationData.time) > maxTimeForRoutingInfoWaiting_)
         {
-            confirmation_waiting_data_t confirmationData = confirmationVector[i];
-            if ((millis() - confirmationData.time) > maxTimeForRoutingInfoWaiting_)
-            {
-                confirmationVector.erase(confirmationVector.begin() + i);
-                broadcastMessage("", confirmationData.targetMAC, SEARCH_REQUEST);
-                if (onConfirmReceivingCallback)
-                    onConfirmReceivingCallback(confirmationData.targetMAC, confirmationData.messageID, false);
-            }
+            ++n;
+            confirmationVector.erase(confirmationVector.begin() + i);
+            broadcastMessage("", confirmationData.targetMAC, SEARCH_REQUEST);
+            updateMessageStatus(confirmationData.messageID, MESSAGE_FAILED_NO_CONFIRM);
+            if (onConfirmReceivingCallback)
+                onConfirmReceivingCallback(confirmationData.targetMAC, confirmationData.messageID, false);
         }
+        else
+            ++i;
+    }
+#endif
+    processBridge();
+    unlock();
+}
+
+#if defined(ESP32)
+error_code_t ZHNetwork::startMaintenanceTask(const uint8_t core, const uint8_t priority, const uint32_t stackSize)
+{
+    if (maintenanceTaskHandle || core > 1 || priority < 1 || priority >= configMAX_PRIORITIES || stackSize < 4096 || stackSize > 65536)
+        return ERROR;
+    if (!maintenanceMutex)
+        maintenanceMutex = xSemaphoreCreateRecursiveMutex();
+    if (!maintenanceMutex)
+        return ERROR;
+    if (xTaskCreatePinnedToCore(maintenanceTask, "ZHNetwork", stackSize, this, priority, &maintenanceTaskHandle, core) != pdPASS)
+    {
+        maintenanceTaskHandle = nullptr;
+        return ERROR;
     }
+    return SUCCESS;
 }
+#endif
 
 String ZHNetwork::getNodeMac()
 {
     return macToString(localMAC);
 }
 
+String ZHNetwork::getGatewayMac()
+{
+    if (gateway_)
+        return macToString(localMAC);
+    return isParentAvailable() ? macToString(gatewayMAC) : "";
+}
+
 String ZHNetwork::getFirmwareVersion()
 {
     return firmware;
@@ -494,6 +905,7 @@ error_code_t ZHNetwork::setMaxWaitingTimeBetweenTransmissions(const uint8_t maxW
     if (maxWaitingTimeBetweenTransmissions < 50 || maxWaitingTimeBetweenTransmissions > 250)
         return ERROR;
     maxWaitingTimeBetweenTransmissions_ = maxWaitingTimeBetweenTransmissions;
+    transmissionInterval = maxWaitingTimeBetweenTransmissions;
     return SUCCESS;
 }
 
@@ -515,155 +927,771 @@ uint16_t ZHNetwork::getMaxWaitingTimeForRoutingInfo()
     return maxTimeForRoutingInfoWaiting_;
 }
 
-#if defined(ESP8266)
-void IRAM_ATTR ZHNetwork::onDataSent(uint8_t *mac, uint8_t status)
-#endif
-#if defined(ESP32)
-    void IRAM_ATTR ZHNetwork::onDataSent(const uint8_t *mac, esp_now_send_status_t status)
-#endif
+error_code_t ZHNetwork::setRoutingPersistence(const bool routingPersistence)
 {
-    confirmReceivingSemaphore = true;
-    confirmReceiving = status ? false : true;
+    routingPersistence_ = routingPersistence;
+    return SUCCESS;
+}
+
+bool ZHNetwork::getRoutingPersistence()
+{
+    return routingPersistence_;
 }
 
+error_code_t ZHNetwork::saveRoutingState()
+{
+    if (!routingPersistence_)
+        return ERROR;
+    lock();
+    routing_snapshot_t snapshot;
+    snapshot.signature = 0x485A;
+    snapshot.version = 1;
+    snapshot.numberOfRoutes = routingVector.size() < 24 ? routingVector.size() : 24;
+    for (uint8_t i{0}; i < snapshot.numberOfRoutes; ++i)
+        snapshot.routingTable[i] = routingVector[routingVector.size() - snapshot.numberOfRoutes + i];
+    if ((int16_t)(messageSequence - sequenceReservation) >= 0)
+        sequenceReservation = messageSequence + 256;
+    snapshot.messageSequence = sequenceReservation;
+    if (!gateway_ && isParentAvailable())
+    {
+        memcpy(&snapshot.gatewayMAC, &gatewayMAC, 6);
+        memcpy(&snapshot.parentMAC, &parentMAC, 6);
+        snapshot.gatewayHops = gatewayHops;
+        snapshot.gatewayBeaconInterval = gatewayBeaconInterval_;
+    }
+    unlock();
+    snapshot.checksum = getChecksum((uint8_t *)&snapshot, sizeof(routing_snapshot_t));
+    if (snapshot.checksum == lastRoutingSnapshotChecksum)
+        return SUCCESS;
 #if defined(ESP8266)
-void IRAM_ATTR ZHNetwork::onDataReceive(uint8_t *mac, uint8_t *data, uint8_t length)
+    if (!ESP.rtcUserMemoryWrite(32, (uint32_t *)&snapshot, sizeof(routing_snapshot_t)))
+        return ERROR;
 #endif
 #if defined(ESP32)
-    void IRAM_ATTR ZHNetwork::onDataReceive(const uint8_t *mac, const uint8_t *data, int length)
+    memcpy(&routingSnapshot, &snapshot, sizeof(routing_snapshot_t));
 #endif
+    lastRoutingSnapshotChecksum = snapshot.checksum;
+    return SUCCESS;
+}
+
+error_code_t ZHNetwork::setGatewayBeaconInterval(const uint16_t gatewayBeaconInterval)
 {
-    if (criticalProcessSemaphore)
-        return;
-    criticalProcessSemaphore = true;
-    if (length != sizeof(transmitted_data_t))
-    {
-        criticalProcessSemaphore = false;
-        return;
-    }
-    incoming_data_t incomingData;
-    memcpy(&incomingData.transmittedData, data, sizeof(transmitted_data_t));
-    if (macToString(incomingData.transmittedData.originalSenderMAC) == macToString(localMAC))
-    {
-        criticalProcessSemaphore = false;
-        return;
-    }
-    if (String(netName_) != "")
-    {
-        if (String(incomingData.transmittedData.netName) != String(netName_))
-        {
-            criticalProcessSemaphore = false;
-            return;
-        }
-    }
-    for (uint8_t i{0}; i < sizeof(lastMessageID) / 2; ++i)
-        if (lastMessageID[i] == incomingData.transmittedData.messageID)
-        {
-            criticalProcessSemaphore = false;
-            return;
-        }
-    for (uint8_t i{sizeof(lastMessageID) / 2 - 1}; i >= 1; --i)
-        lastMessageID[i] = lastMessageID[i - 1];
-    lastMessageID[0] = incomingData.transmittedData.messageID;
-    memcpy(&incomingData.intermediateSenderMAC, mac, 6);
-    queueForIncomingData.push(incomingData);
-    criticalProcessSemaphore = false;
+    if (gatewayBeaconInterval < 10 || gatewayBeaconInterval > 3600)
+        return ERROR;
+    gatewayBeaconInterval_ = gatewayBeaconInterval;
+    return SUCCESS;
 }
 
-uint16_t ZHNetwork::broadcastMessage(const char *data, const uint8_t *target, message_type_t type)
+uint16_t ZHNetwork::getGatewayBeaconInterval()
 {
-    outgoing_data_t outgoingData;
-    outgoingData.transmittedData.messageType = type;
-    outgoingData.transmittedData.messageID = ((uint16_t)random(32767) << 8) | (uint16_t)random(32767);
-    memcpy(&outgoingData.transmittedData.netName, &netName_, 20);
-    memcpy(&outgoingData.transmittedData.originalTargetMAC, target, 6);
-    memcpy(&outgoingData.transmittedData.originalSenderMAC, &localMAC, 6);
-    strcpy(outgoingData.transmittedData.message, data);
-    if (key_[0] && outgoingData.transmittedData.messageType == BROADCAST)
-        for (uint8_t i{0}; i < strlen(outgoingData.transmittedData.message); ++i)
-            outgoingData.transmittedData.message[i] = outgoingData.transmittedData.message[i] ^ key_[i % strlen(key_)];
-    memcpy(&outgoingData.intermediateTargetMAC, &broadcastMAC, 6);
-    queueForOutgoingData.push(outgoingData);
-#ifdef PRINT_LOG
-    switch (outgoingData.transmittedData.messageType)
-    {
-    case BROADCAST:
-        Serial.print(F("BROADCAST"));
-        break;
-    case SEARCH_REQUEST:
-        Serial.print(F("SEARCH_REQUEST"));
-        break;
-    case SEARCH_RESPONSE:
-        Serial.print(F("SEARCH_RESPONSE"));
-        break;
-    default:
-        break;
-    }
-    Serial.print(F(" message from MAC "));
-    Serial.print(macToString(outgoingData.transmittedData.originalSenderMAC));
-    Serial.print(F(" to MAC "));
-    Serial.print(macToString(outgoingData.transmittedData.originalTargetMAC));
-    Serial.println(F(" added to queue."));
-#endif
-    return outgoingData.transmittedData.messageID;
+    return gatewayBeaconInterval_;
 }
 
-uint16_t ZHNetwork::unicastMessage(const char *data, const uint8_t *target, const uint8_t *sender, message_type_t type)
+error_code_t ZHNetwork::setSlottedTransmission(const uint8_t slotLength, const uint8_t slotCount)
 {
-    outgoing_data_t outgoingData;
-    outgoingData.transmittedData.messageType = type;
-    outgoingData.transmittedData.messageID = ((uint16_t)random(32767) << 8) | (uint16_t)random(32767);
-    memcpy(&outgoingData.transmittedData.netName, &netName_, 20);
-    memcpy(&outgoingData.transmittedData.originalTargetMAC, target, 6);
-    memcpy(&outgoingData.transmittedData.originalSenderMAC, sender, 6);
-    strcpy(outgoingData.transmittedData.message, data);
-    if (key_[0] && macToString(outgoingData.transmittedData.originalSenderMAC) == macToString(localMAC) && outgoingData.transmittedData.messageType != DELIVERY_CONFIRM_RESPONSE)
-        for (uint8_t i{0}; i < strlen(outgoingData.transmittedData.message); ++i)
-            outgoingData.transmittedData.message[i] = outgoingData.transmittedData.message[i] ^ key_[i % strlen(key_)];
-    for (uint16_t i{0}; i < routingVector.size(); ++i)
-    {
-        routing_table_t routingTable = routingVector[i];
-        if (macToString(routingTable.originalTargetMAC) == macToString(target))
-        {
-            memcpy(&outgoingData.intermediateTargetMAC, &routingTable.intermediateTargetMAC, 6);
-            queueForOutgoingData.push(outgoingData);
-#ifdef PRINT_LOG
-            Serial.print(F("CHECKING ROUTING TABLE... Routing to MAC "));
-            Serial.print(macToString(outgoingData.transmittedData.originalTargetMAC));
-            Serial.print(F(" found. Target is "));
-            Serial.print(macToString(outgoingData.intermediateTargetMAC));
-            Serial.println(F("."));
-            switch (outgoingData.transmittedData.messageType)
-            {
-            case UNICAST:
-                Serial.print(F("UNICAST"));
-                break;
-            case UNICAST_WITH_CONFIRM:
-                Serial.print(F("UNICAST_WITH_CONFIRM"));
-                break;
-            case DELIVERY_CONFIRM_RESPONSE:
-                Serial.print(F("DELIVERY_CONFIRM_RESPONSE"));
-                break;
-            default:
-                break;
+    if (slotCount && (slotCount < 2 || slotCount > 100 || slotLength < 5 || slotLength > 100))
+        return ERROR;
+    lock();
+    slotLength_ = slotCount ? slotLength : 0;
+    slotCount_ = slotCount;
+    unlock();
+    return SUCCESS;
+}
+
+uint8_t ZHNetwork::getSlotLength()
+{
+    return slotLength_;
+}
+
+uint8_t ZHNetwork::getSlotCount()
+{
+    return slotCount_;
+}
+
+bool ZHNetwork::isTimeSynchronized()
+{
+    return gateway_ || (timeSynchronized && isParentAvailable());
+}
+
+uint32_t ZHNetwork::getNetworkTime()
+{
+    return gateway_ ? millis() : millis() + networkTimeOffset;
+}
+
+error_code_t ZHNetwork::setMaintenanceBudget(const maintenance_budget_t &maintenanceBudget)
+{
+    if (maintenanceBudget.incoming < 1 || maintenanceBudget.incoming > 50)
+        return ERROR;
+    if (maintenanceBudget.forwarding < 1 || maintenanceBudget.forwarding > 50)
+        return ERROR;
+    if (maintenanceBudget.routingWaiting < 1 || maintenanceBudget.routingWaiting > 50)
+        return ERROR;
+    if (maintenanceBudget.confirmation < 1 || maintenanceBudget.confirmation > 50)
+        return ERROR;
+    if (maintenanceBudget.timeSlice && (maintenanceBudget.timeSlice < 100 || maintenanceBudget.timeSlice > 50000))
+        return ERROR;
+    maintenanceBudget_ = maintenanceBudget;
+    return SUCCESS;
+}
+
+maintenance_budget_t ZHNetwork::getMaintenanceBudget()
+{
+    return maintenanceBudget_;
+}
+
+error_code_t ZHNetwork::setQueueLimits(const queue_limits_t &queueLimits)
+{
+    if (queueLimits.incoming < 1 || queueLimits.incoming > ZHNETWORK_QUEUE_SIZE)
+        return ERROR;
+    if (queueLimits.outgoing < 1 || queueLimits.outgoing > ZHNETWORK_QUEUE_SIZE)
+        return ERROR;
+    if (queueLimits.routingWaiting < 1 || queueLimits.routingWaiting > ZHNETWORK_QUEUE_SIZE)
+        return ERROR;
+    if (queueLimits.dropPolicy < DROP_NEWEST || queueLimits.dropPolicy > DROP_DATA_FIRST)
+        return ERROR;
+    lock();
+    queueLimits_ = queueLimits;
+    unlock();
+    return SUCCESS;
+}
+
+queue_limits_t ZHNetwork::getQueueLimits()
+{
+    return queueLimits_;
+}
+
+uint8_t ZHNetwork::getOutgoingQueueSpace()
+{
+    lock();
+    uint8_t space = queueForOutgoingData.size() < queueLimits_.outgoing ? queueLimits_.outgoing - queueForOutgoingData.size() : 0;
+    unlock();
+    return space;
+}
+
+error_code_t ZHNetwork::setAdaptiveRateControl(const bool adaptiveRateControl)
+{
+    lock();
+    adaptiveRateControl_ = adaptiveRateControl;
+    transmissionInterval = maxWaitingTimeBetweenTransmissions_;
+    unlock();
+    return SUCCESS;
+}
+
+bool ZHNetwork::getAdaptiveRateControl()
+{
+    return adaptiveRateControl_;
+}
+
+uint16_t ZHNetwork::getTransmissionInterval()
+{
+    return transmissionInterval;
+}
+
+error_code_t ZHNetwork::setCompression(const bool compression)
+{
+#ifdef ZHNETWORK_NO_COMPRESSION
+    if (compression)
+        return ERROR;
+#endif
+    compression_ = compression;
+    return SUCCESS;
+}
+
+bool ZHNetwork::getCompression()
+{
+    return compression_;
+}
+
+statistics_t ZHNetwork::getStatistics()
+{
+    return statistics;
+}
+
+error_code_t ZHNetwork::startBridge(Stream &stream, const uint16_t statisticsInterval)
+{
+    if (statisticsInterval > 3600)
+        return ERROR;
+    lock();
+    bridgeStream = &stream;
+    bridgeStatisticsInterval_ = statisticsInterval;
+    lastBridgeStatisticsTime = millis();
+    bridgeTxBuffer.resize(ZHNETWORK_BRIDGE_BUFFER_SIZE);
+    bridgeTxHead = 0;
+    bridgeTxTail = 0;
+    bridgeRxBuffer.clear();
+    bridgeRxBuffer.reserve(ZHNETWORK_BRIDGE_FRAME_SIZE);
+    bridgeRxOverflow = false;
+    unlock();
+    return SUCCESS;
+}
+
+void ZHNetwork::stopBridge()
+{
+    lock();
+    bridgeStream = nullptr;
+    std::vector<uint8_t>().swap(bridgeTxBuffer);
+    std::vector<uint8_t>().swap(bridgeRxBuffer);
+    unlock();
+}
+
+#if defined(ESP8266)
+void IRAM_ATTR ZHNetwork::onDataSent(uint8_t *mac, uint8_t status)
+#endif
+#if defined(ESP32)
+    void IRAM_ATTR ZHNetwork::onDataSent(const uint8_t *mac, esp_now_send_status_t status)
+#endif
+{
+    confirmReceivingSemaphore = true;
+    confirmReceiving = status ? false : true;
+    notifyMaintenanceTask();
+}
+
+#if defined(ESP8266)
+void IRAM_ATTR ZHNetwork::onDataReceive(uint8_t *mac, uint8_t *data, uint8_t length)
+#endif
+#if defined(ESP32)
+    void IRAM_ATTR ZHNetwork::onDataReceive(const uint8_t *mac, const uint8_t *data, int length)
+#endif
+{
+    if (length != sizeof(transmitted_data_t))
+        return;
+    incoming_data_t incomingData;
+    incomingData.time = millis();
+    memcpy(&incomingData.transmittedData, data, sizeof(transmitted_data_t));
+    incomingData.transmittedData.message[ZHNETWORK_MAX_MESSAGE_LENGTH - 1] = 0; // Last byte is never used by valid frames.
+    if (macToString(incomingData.transmittedData.originalSenderMAC) == macToString(localMAC))
+        return;
+    if (netName_[0])
+        if (strncmp(incomingData.transmittedData.netName, netName_, sizeof(transmitted_data_t::netName)))
+            return;
+    ++statistics.receivedFrames;
+    if (isFloodMessage(incomingData.transmittedData.messageType))
+        ++statistics.floodFramesReceived;
+    if (isDuplicate(incomingData.transmittedData.originalSenderMAC, incomingData.transmittedData.messageID))
+    {
+        ++statistics.duplicateFrames;
+        return;
+    }
+    memcpy(&incomingData.intermediateSenderMAC, mac, 6);
+    pushIncomingData(incomingData);
+    notifyMaintenanceTask();
+}
+
+void ZHNetwork::cryptMessage(char *message, const uint8_t length)
+{
+#ifndef ZHNETWORK_NO_CRYPT
+    if (key_[0])
+        for (uint8_t i{0}, keyLength = strlen(key_); i < length; ++i)
+            message[i] = message[i] ^ key_[i % keyLength];
+#else
+    (void)message;
+    (void)length;
+#endif
+}
+
+void ZHNetwork::packMessage(transmitted_data_t &transmittedData, const char *data)
+{
+#ifndef ZHNETWORK_NO_COMPRESSION
+    if (compression_)
+    {
+        uint8_t length = compressMessage(data, (uint8_t *)transmittedData.message + 1);
+        if (length)
+        {
+            transmittedData.messageFlags |= MESSAGE_COMPRESSED;
+            transmittedData.message[0] = length;
+            cryptMessage(transmittedData.message + 1, length);
+            return;
+        }
+    }
+#endif
+    strncpy(transmittedData.message, data, ZHNETWORK_MAX_MESSAGE_LENGTH - 1);
+    cryptMessage(transmittedData.message, strnlen(transmittedData.message, ZHNETWORK_MAX_MESSAGE_LENGTH));
+}
+
+bool ZHNetwork::unpackMessage(transmitted_data_t &transmittedData)
+{
+    if (!(transmittedData.messageFlags & MESSAGE_COMPRESSED))
+    {
+        cryptMessage(transmittedData.message, strnlen(transmittedData.message, ZHNETWORK_MAX_MESSAGE_LENGTH));
+        return true;
+    }
+#ifdef ZHNETWORK_NO_COMPRESSION
+    return false;
+#else
+    uint8_t length = transmittedData.message[0];
+    if (!length || length > ZHNETWORK_MAX_MESSAGE_LENGTH - 2)
+        return false;
+    cryptMessage(transmittedData.message + 1, length);
+    char temp[sizeof(transmitted_data_t::message)];
+    if (!decompressMessage((uint8_t *)transmittedData.message + 1, length, temp))
+        return false;
+    memcpy(&transmittedData.message, &temp, sizeof(transmitted_data_t::message));
+    return true;
+#endif
+}
+
+#ifndef ZHNETWORK_NO_COMPRESSION
+uint8_t ZHNetwork::getCompressionByte(const uint8_t *data, const uint16_t index)
+{
+    if (index < sizeof(compressionDictionary) - 1)
+        return pgm_read_byte(compressionDictionary + index);
+    return data[index - (sizeof(compressionDictionary) - 1)];
+}
+
+uint8_t ZHNetwork::compressMessage(const char *data, uint8_t *compressed)
+{
+    // Literal run: 0LLLLLLL (1-128 bytes follow). Match: 1LLLLLDD DDDDDDDD (3-34 bytes at distance 1-1024 in dictionary + data).
+    const uint16_t dictionaryLength = sizeof(compressionDictionary) - 1;
+    uint16_t length = strnlen(data, ZHNETWORK_MAX_MESSAGE_LENGTH - 1);
+    if (length < 4)
+        return 0;
+    uint16_t position{0};
+    uint16_t literalStart{0};
+    uint16_t compressedLength{0};
+    while (true)
+    {
+        uint8_t matchLength{0};
+        uint16_t matchDistance{0};
+        for (uint16_t distance{1}; position < length && distance <= 1024 && distance <= dictionaryLength + position; ++distance)
+        {
+            uint8_t currentLength{0};
+            while (currentLength < 34 && position + currentLength < length && getCompressionByte((const uint8_t *)data, dictionaryLength + position + currentLength - distance) == (uint8_t)data[position + currentLength])
+                ++currentLength;
+            if (currentLength > matchLength)
+            {
+                matchLength = currentLength;
+                matchDistance = distance;
             }
-            Serial.print(F(" message from MAC "));
-            Serial.print(macToString(outgoingData.transmittedData.originalSenderMAC));
-            Serial.print(F(" to MAC "));
-            Serial.print(macToString(outgoingData.transmittedData.originalTargetMAC));
-            Serial.print(F(" via MAC "));
-            Serial.print(macToString(outgoingData.intermediateTargetMAC));
-            Serial.println(F(" added to queue."));
+        }
+        if (literalStart < position && (matchLength >= 3 || position == length || position - literalStart == 128))
+        {
+            uint8_t count = position - literalStart;
+            if (compressedLength + count + 1 >= length)
+                return 0;
+            compressed[compressedLength++] = count - 1;
+            memcpy(compressed + compressedLength, data + literalStart, count);
+            compressedLength += count;
+            literalStart = position;
+        }
+        if (position == length)
+            break;
+        if (matchLength >= 3)
+        {
+            if (compressedLength + 2 >= length)
+                return 0;
+            compressed[compressedLength++] = 0x80 | ((matchLength - 3) << 2) | ((matchDistance - 1) >> 8);
+            compressed[compressedLength++] = (matchDistance - 1) & 0xFF;
+            position += matchLength;
+            literalStart = position;
+        }
+        else
+            ++position;
+    }
+    return compressedLength;
+}
+
+bool ZHNetwork::decompressMessage(const uint8_t *compressed, const uint8_t length, char *data)
+{
+    const uint16_t dictionaryLength = sizeof(compressionDictionary) - 1;
+    uint16_t position{0};
+    for (uint16_t i{0}; i < length;)
+    {
+        uint8_t control = compressed[i++];
+        uint8_t count = control < 0x80 ? control + 1 : ((control >> 2) & 0x1F) + 3;
+        if (position + count > ZHNETWORK_MAX_MESSAGE_LENGTH - 1)
+            return false;
+        if (control < 0x80)
+        {
+            if (i + count > length)
+                return false;
+            memcpy(data + position, compressed + i, count);
+            i += count;
+            position += count;
+            continue;
+        }
+        if (i >= length)
+            return false;
+        uint16_t distance = (((control & 0x03) << 8) | compressed[i++]) + 1;
+        if (distance > dictionaryLength + position)
+            return false;
+        for (; count; --count, ++position)
+            data[position] = getCompressionByte((const uint8_t *)data, dictionaryLength + position - distance);
+    }
+    data[position] = 0;
+    return true;
+}
+#endif
+
+bool ZHNetwork::isDuplicate(const uint8_t *senderMAC, const uint16_t messageID)
+{
+    uint8_t index{ZHNETWORK_DUPLICATE_FILTER_SIZE - 1};
+    for (uint8_t i{0}; i < ZHNETWORK_DUPLICATE_FILTER_SIZE; ++i)
+        if (!memcmp(duplicateFilter[i].senderMAC, senderMAC, 6))
+        {
+            index = i;
+            break;
+        }
+    duplicate_filter_t filter = duplicateFilter[index];
+    for (uint8_t i{index}; i >= 1; --i)
+        duplicateFilter[i] = duplicateFilter[i - 1];
+    if (memcmp(filter.senderMAC, senderMAC, 6))
+    {
+        memcpy(&filter.senderMAC, senderMAC, 6);
+        filter.lastMessageID = messageID;
+        filter.receivedMessages = 0;
+        duplicateFilter[0] = filter;
+        return false;
+    }
+    bool duplicate{false};
+    int16_t difference = (int16_t)(messageID - filter.lastMessageID);
+    if (difference > 0)
+    {
+        if (difference < 32)
+            filter.receivedMessages = (filter.receivedMessages << difference) | (1UL << (difference - 1));
+        else
+            filter.receivedMessages = difference == 32 ? 1UL << 31 : 0;
+        filter.lastMessageID = messageID;
+    }
+    else if (difference == 0)
+        duplicate = true;
+    else if (-difference > 32)
+    {
+        filter.lastMessageID = messageID; // The sender has most likely been restarted.
+        filter.receivedMessages = 0;
+    }
+    else if (filter.receivedMessages & (1UL << (-difference - 1)))
+        duplicate = true;
+    else
+        filter.receivedMessages |= 1UL << (-difference - 1);
+    duplicateFilter[0] = filter;
+    return duplicate;
+}
+
+bool ZHNetwork::isFloodMessage(const uint8_t messageType)
+{
+    return messageType == BROADCAST || messageType == SEARCH_REQUEST || messageType == SEARCH_RESPONSE || messageType == GATEWAY_BEACON;
+}
+
+bool ZHNetwork::isControlMessage(const uint8_t messageType)
+{
+    return messageType != BROADCAST && messageType != UNICAST && messageType != UNICAST_WITH_CONFIRM && messageType != GROUP_MESSAGE;
+}
+
+template <typename T>
+int16_t ZHNetwork::getDropIndex(const std::deque<T> &queue, const T &data, const uint8_t firstIndex)
+{
+    switch (queueLimits_.dropPolicy)
+    {
+    case DROP_OLDEST:
+        if (queue.size() > firstIndex)
+            return firstIndex;
+        break;
+    case DROP_DATA_FIRST:
+        if (!isControlMessage(data.transmittedData.messageType))
+            break;
+        for (int16_t i = queue.size() - 1; i >= firstIndex; --i)
+            if (!isControlMessage(queue[i].transmittedData.messageType))
+                return i;
+        break;
+    default:
+        break;
+    }
+    return -1; // The new message is dropped.
+}
+
+bool ZHNetwork::pushIncomingData(const incoming_data_t &incomingData)
+{
+#if defined(ESP8266)
+    if (criticalProcessSemaphore)
+    {
+        ++statistics.droppedFrames;
+        return false;
+    }
+#endif
+#if defined(ESP32)
+    portENTER_CRITICAL(&incomingQueueSpinlock); // Receive callback and maintenance task may run on different cores.
+#endif
+    bool pushed{true};
+    while (queueForIncomingData.size() >= queueLimits_.incoming)
+    {
+        int16_t index = getDropIndex(queueForIncomingData, incomingData, 0);
+        ++statistics.droppedFrames;
+        if (index < 0)
+        {
+            pushed = false;
+            break;
+        }
+        queueForIncomingData.erase(queueForIncomingData.begin() + index);
+    }
+    if (pushed)
+        queueForIncomingData.push_back(incomingData);
+#if defined(ESP32)
+    portEXIT_CRITICAL(&incomingQueueSpinlock);
+#endif
+    return pushed;
+}
+
+bool ZHNetwork::popIncomingData(incoming_data_t &incomingData)
+{
+#if defined(ESP8266)
+    criticalProcessSemaphore = true;
+#endif
+#if defined(ESP32)
+    portENTER_CRITICAL(&incomingQueueSpinlock);
+#endif
+    bool popped = !queueForIncomingData.empty();
+    if (popped)
+    {
+        incomingData = queueForIncomingData.front();
+        queueForIncomingData.pop_front();
+    }
+#if defined(ESP8266)
+    criticalProcessSemaphore = false;
+#endif
+#if defined(ESP32)
+    portEXIT_CRITICAL(&incomingQueueSpinlock);
+#endif
+    return popped;
+}
+
+bool ZHNetwork::pushOutgoingData(const outgoing_data_t &outgoingData)
+{
+    std::vector<transmitted_data_t> droppedData;
+    bool pushed{true};
+    while (queueForOutgoingData.size() >= queueLimits_.outgoing)
+    {
+        int16_t index = droppingMessages ? -1 : getDropIndex(queueForOutgoingData, outgoingData, (sentMessageSemaphore || numberOfAttemptsToSend > 1) ? 1 : 0); // The first message may be in transmission.
+        ++statistics.droppedFrames;
+        if (index < 0)
+        {
+            pushed = false;
+            break;
+        }
+        droppedData.push_back(queueForOutgoingData[index].transmittedData);
+        queueForOutgoingData.erase(queueForOutgoingData.begin() + index);
+    }
+    if (pushed)
+        queueForOutgoingData.push_back(outgoingData);
+    for (transmitted_data_t &transmittedData : droppedData) // Callbacks are called only after the queue is consistent.
+        dropMessage(transmittedData);
+    return pushed;
+}
+
+bool ZHNetwork::pushWaitingData(const waiting_data_t &waitingData)
+{
+    std::vector<transmitted_data_t> droppedData;
+    bool pushed{true};
+    while (queueForRoutingVectorWaiting.size() >= queueLimits_.routingWaiting)
+    {
+        int16_t index = droppingMessages ? -1 : getDropIndex(queueForRoutingVectorWaiting, waitingData, 0);
+        ++statistics.droppedFrames;
+        if (index < 0)
+        {
+            pushed = false;
+            break;
+        }
+        droppedData.push_back(queueForRoutingVectorWaiting[index].transmittedData);
+        queueForRoutingVectorWaiting.erase(queueForRoutingVectorWaiting.begin() + index);
+    }
+    if (pushed)
+        queueForRoutingVectorWaiting.push_back(waitingData);
+    for (transmitted_data_t &transmittedData : droppedData)
+        dropMessage(transmittedData);
+    return pushed;
+}
+
+void ZHNetwork::dropMessage(const transmitted_data_t &transmittedData)
+{
+#ifdef PRINT_LOG
+    Serial.print(F("CHECKING QUEUE... Message from MAC "));
+    Serial.print(macToString(transmittedData.originalSenderMAC));
+    Serial.print(F(" to MAC "));
+    Serial.print(macToString(transmittedData.originalTargetMAC));
+    Serial.println(F(" dropped."));
+#endif
+    if (macToString(transmittedData.originalSenderMAC) != macToString(localMAC))
+        return;
+    bool dropping = droppingMessages;
+    droppingMessages = true; // Messages sent from the callbacks must not evict other messages.
+    updateMessageStatus(transmittedData.messageID, MESSAGE_FAILED_QUEUE_FULL);
+    if (transmittedData.messageType == UNICAST_WITH_CONFIRM && onConfirmReceivingCallback)
+        onConfirmReceivingCallback(transmittedData.originalTargetMAC, transmittedData.messageID, false);
+    droppingMessages = dropping;
+}
+
+#if defined(ESP32)
+void ZHNetwork::maintenanceTask(void *parameter)
+{
+    ZHNetwork *network = (ZHNetwork *)parameter;
+    for (;;)
+    {
+        network->maintenance();
+        uint32_t timeToNextEvent = network->getTimeToNextEvent();
+        if (timeToNextEvent)
+            ulTaskNotifyTake(pdTRUE, timeToNextEvent == UINT32_MAX ? portMAX_DELAY : pdMS_TO_TICKS(timeToNextEvent));
+    }
+}
+#endif
+
+void ZHNetwork::lock()
+{
+#if defined(ESP32)
+    if (maintenanceMutex)
+        xSemaphoreTakeRecursive(maintenanceMutex, portMAX_DELAY);
+#endif
+}
+
+void ZHNetwork::unlock()
+{
+#if defined(ESP32)
+    if (maintenanceMutex)
+        xSemaphoreGiveRecursive(maintenanceMutex);
 #endif
-            return outgoingData.transmittedData.messageID;
+}
+
+void ZHNetwork::notifyMaintenanceTask()
+{
+#if defined(ESP32)
+    if (maintenanceTaskHandle)
+        xTaskNotifyGive(maintenanceTaskHandle);
+#endif
+}
+
+bool ZHNetwork::isTimeSliceExceeded(const uint32_t startTime)
+{
+    return maintenanceBudget_.timeSlice && (micros() - startTime) >= maintenanceBudget_.timeSlice;
+}
+
+uint32_t ZHNetwork::getTimeToNextEvent()
+{
+    uint32_t timeToNextEvent{UINT32_MAX};
+    lock();
+#if defined(ESP32)
+    portENTER_CRITICAL(&incomingQueueSpinlock);
+#endif
+    if (!queueForIncomingData.empty() || (sentMessageSemaphore && confirmReceivingSemaphore))
+        timeToNextEvent = 0;
+#if defined(ESP32)
+    portEXIT_CRITICAL(&incomingQueueSpinlock);
+#endif
+    if (timeToNextEvent && !queueForOutgoingData.empty())
+    {
+        uint32_t transmissionTime = millis() - lastMessageSentTime;
+        uint32_t forwardingTime = millis() - lastForwardingTime;
+        transmissionTime = transmissionTime > transmissionInterval ? 0 : transmissionInterval + 1 - transmissionTime;
+        forwardingTime = forwardingTime >= forwardingDelay ? 0 : forwardingDelay - forwardingTime;
+        timeToNextEvent = transmissionTime > forwardingTime ? transmissionTime : forwardingTime;
+        if (slotCount_ && isTimeSynchronized())
+        {
+            uint32_t backoffTime = millis() - lastMessageSentTime;
+            uint16_t backoff = transmissionInterval > maxWaitingTimeBetweenTransmissions_ ? transmissionInterval - maxWaitingTimeBetweenTransmissions_ : 0;
+            backoffTime = backoffTime >= backoff ? 0 : backoff - backoffTime;
+            timeToNextEvent = getTimeToSlot();
+            if (!timeToNextEvent)
+                timeToNextEvent = sentMessageSemaphore ? transmissionTime : backoffTime;
         }
     }
-    memcpy(&outgoingData.intermediateTargetMAC, target, 6);
-    queueForOutgoingData.push(outgoingData);
+    if (gateway_)
+    {
+        uint32_t beaconTime = millis() - lastGatewayBeaconTime;
+        beaconTime = !lastGatewayBeaconTime || beaconTime > gatewayBeaconInterval_ * 1000UL ? 0 : gatewayBeaconInterval_ * 1000UL + 1 - beaconTime;
+        if (beaconTime < timeToNextEvent)
+            timeToNextEvent = beaconTime;
+    }
+    if (groupJoinPending && isParentAvailable())
+    {
+        uint32_t groupJoinTime = millis() - lastGroupJoinTime;
+        groupJoinTime = groupJoinTime >= groupJoinDelay ? 0 : groupJoinDelay - groupJoinTime;
+        if (groupJoinTime < timeToNextEvent)
+            timeToNextEvent = groupJoinTime;
+    }
+    if (timeToNextEvent && !queueForRoutingVectorWaiting.empty() && timeToNextEvent > maxWaitingTimeBetweenTransmissions_)
+        timeToNextEvent = maxWaitingTimeBetweenTransmissions_;
+    if (timeToNextEvent && bridgeStream)
+        timeToNextEvent = 1; // Serial port is polled.
+    for (uint16_t i{0}; timeToNextEvent && i < confirmationVector.size(); ++i)
+    {
+        uint32_t waitingTime = millis() - confirmationVector[i].time;
+        waitingTime = waitingTime > maxTimeForRoutingInfoWaiting_ ? 0 : maxTimeForRoutingInfoWaiting_ + 1 - waitingTime;
+        if (waitingTime < timeToNextEvent)
+            timeToNextEvent = waitingTime;
+    }
+    unlock();
+    return timeToNextEvent;
+}
+
+uint16_t ZHNetwork::broadcastMessage(const char *data, const uint8_t *target, message_type_t type)
+{
+    outgoing_data_t outgoingData;
+    outgoingData.transmittedData.messageType = type;
+    outgoingData.transmittedData.messageID = getNextMessageID();
+    memcpy(&outgoingData.transmittedData.netName, &netName_, sizeof(transmitted_data_t::netName));
+    memcpy(&outgoingData.transmittedData.originalTargetMAC, target, 6);
+    memcpy(&outgoingData.transmittedData.originalSenderMAC, &localMAC, 6);
+    if (type == GATEWAY_BEACON)
+        memcpy(&outgoingData.transmittedData.message, data, sizeof(transmitted_data_t::message));
+    else if (type == BROADCAST)
+        packMessage(outgoingData.transmittedData, data);
+    else
+        strncpy(outgoingData.transmittedData.message, data, ZHNETWORK_MAX_MESSAGE_LENGTH - 1);
+    memcpy(&outgoingData.intermediateTargetMAC, &broadcastMAC, 6);
+    if (!pushOutgoingData(outgoingData))
+        return 0;
+#ifdef PRINT_LOG
+    switch (outgoingData.transmittedData.messageType)
+    {
+    case BROADCAST:
+        Serial.print(F("BROADCAST"));
+        break;
+    case SEARCH_REQUEST:
+        Serial.print(F("SEARCH_REQUEST"));
+        break;
+    case SEARCH_RESPONSE:
+        Serial.print(F("SEARCH_RESPONSE"));
+        break;
+    case GATEWAY_BEACON:
+        Serial.print(F("GATEWAY_BEACON"));
+        break;
+    default:
+        break;
+    }
+    Serial.print(F(" message from MAC "));
+    Serial.print(macToString(outgoingData.transmittedData.originalSenderMAC));
+    Serial.print(F(" to MAC "));
+    Serial.print(macToString(outgoingData.transmittedData.originalTargetMAC));
+    Serial.println(F(" added to queue."));
+#endif
+    return outgoingData.transmittedData.messageID;
+}
+
+uint16_t ZHNetwork::unicastMessage(const char *data, const uint8_t *target, message_type_t type)
+{
+    outgoing_data_t outgoingData;
+    outgoingData.transmittedData.messageType = type;
+    outgoingData.transmittedData.messageID = getNextMessageID();
+    memcpy(&outgoingData.transmittedData.netName, &netName_, sizeof(transmitted_data_t::netName));
+    memcpy(&outgoingData.transmittedData.originalTargetMAC, target, 6);
+    memcpy(&outgoingData.transmittedData.originalSenderMAC, &localMAC, 6);
+    if (type == DELIVERY_CONFIRM_RESPONSE || type == GROUP_JOIN)
+        memcpy(&outgoingData.transmittedData.message, data, sizeof(transmitted_data_t::message));
+    else
+        packMessage(outgoingData.transmittedData, data);
+    if (!routeMessage(outgoingData))
+        return 0;
+    return outgoingData.transmittedData.messageID;
+}
+
+bool ZHNetwork::routeMessage(outgoing_data_t &outgoingData)
+{
+    bool routeFound = findRoute(outgoingData.transmittedData.originalTargetMAC, outgoingData.intermediateTargetMAC);
+    if (!routeFound)
+        memcpy(&outgoingData.intermediateTargetMAC, &outgoingData.transmittedData.originalTargetMAC, 6);
+    if (!pushOutgoingData(outgoingData))
+        return false;
 #ifdef PRINT_LOG
     Serial.print(F("CHECKING ROUTING TABLE... Routing to MAC "));
     Serial.print(macToString(outgoingData.transmittedData.originalTargetMAC));
-    Serial.print(F(" not found. Target is "));
+    Serial.print(routeFound ? F(" found. Target is ") : F(" not found. Target is "));
     Serial.print(macToString(outgoingData.intermediateTargetMAC));
     Serial.println(F("."));
     switch (outgoingData.transmittedData.messageType)
@@ -677,6 +1705,9 @@ uint16_t ZHNetwork::unicastMessage(const char *data, const uint8_t *target, cons
     case DELIVERY_CONFIRM_RESPONSE:
         Serial.print(F("DELIVERY_CONFIRM_RESPONSE"));
         break;
+    case GROUP_JOIN:
+        Serial.print(F("GROUP_JOIN"));
+        break;
     default:
         break;
     }
@@ -688,5 +1719,406 @@ uint16_t ZHNetwork::unicastMessage(const char *data, const uint8_t *target, cons
     Serial.print(macToString(outgoingData.intermediateTargetMAC));
     Serial.println(F(" added to queue."));
 #endif
-    return outgoingData.transmittedData.messageID;
-}
\ No newline at end of file
+    return true;
+}
+
+uint8_t ZHNetwork::multicastMessage(const transmitted_data_t &transmittedData, const uint8_t *senderMAC)
+{
+    uint8_t numberOfCopies{0};
+    outgoing_data_t outgoingData;
+    memcpy(&outgoingData.transmittedData, &transmittedData, sizeof(transmitted_data_t));
+    if (!gateway_ && !isParentAvailable())
+    {
+        memcpy(&outgoingData.intermediateTargetMAC, &broadcastMAC, 6);
+        if (!pushOutgoingData(outgoingData))
+            return 0;
+        lastForwardingTime = millis();
+        forwardingDelay = random(10);
+        return 1;
+    }
+    if (!gateway_ && macToString(senderMAC) != macToString(parentMAC))
+    {
+        memcpy(&outgoingData.intermediateTargetMAC, &parentMAC, 6);
+        if (pushOutgoingData(outgoingData))
+            ++numberOfCopies;
+    }
+    uint16_t group = macToGroup(transmittedData.originalTargetMAC);
+    for (uint16_t i{0}; i < groupRoutingVector.size();)
+    {
+        group_routing_t groupRouting = groupRoutingVector[i];
+        if ((millis() - groupRouting.time) > gatewayBeaconInterval_ * 3000UL)
+        {
+            groupRoutingVector.erase(groupRoutingVector.begin() + i);
+            continue;
+        }
+        if (groupRouting.group == group && macToString(groupRouting.nextHopMAC) != macToString(senderMAC))
+        {
+            memcpy(&outgoingData.intermediateTargetMAC, &groupRouting.nextHopMAC, 6);
+            if (pushOutgoingData(outgoingData))
+                ++numberOfCopies;
+        }
+        ++i;
+    }
+#ifdef PRINT_LOG
+    Serial.print(F("CHECKING GROUP TABLE... GROUP_MESSAGE message from MAC "));
+    Serial.print(macToString(transmittedData.originalSenderMAC));
+    Serial.print(F(" to group "));
+    Serial.print(group);
+    Serial.print(F(" added to queue "));
+    Serial.print(numberOfCopies);
+    Serial.println(F(" times."));
+#endif
+    return numberOfCopies;
+}
+
+bool ZHNetwork::isGroupMember(const uint16_t group)
+{
+    for (uint8_t i{0}; i < groupVector.size(); ++i)
+        if (groupVector[i] == group)
+            return true;
+    return false;
+}
+
+uint16_t ZHNetwork::macToGroup(const uint8_t *mac)
+{
+    return (mac[4] << 8) | mac[5];
+}
+
+bool ZHNetwork::findRoute(const uint8_t *target, uint8_t *intermediateTargetMAC)
+{
+    if (isParentAvailable() && macToString(target) == macToString(gatewayMAC))
+    {
+        memcpy(intermediateTargetMAC, &parentMAC, 6);
+        return true;
+    }
+    for (uint16_t i{0}; i < routingVector.size(); ++i)
+    {
+        routing_table_t routingTable = routingVector[i];
+        if (macToString(routingTable.originalTargetMAC) == macToString(target))
+        {
+            memcpy(intermediateTargetMAC, &routingTable.intermediateTargetMAC, 6);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ZHNetwork::isParentAvailable()
+{
+    return gatewayHops && (millis() - lastGatewayBeaconTime) <= gatewayBeaconInterval_ * 3000UL;
+}
+
+uint32_t ZHNetwork::getTimeToSlot()
+{
+    uint32_t superframe = slotLength_ * slotCount_;
+    if (!superframe)
+        return 0;
+    uint32_t position = getNetworkTime() % superframe;
+    uint32_t slotStart = (getChecksum(localMAC, 6) % slotCount_) * slotLength_;
+    if (position >= slotStart && position + 2 < slotStart + slotLength_) // Last 2 ms of slot are left for clock error.
+        return 0;
+    return (slotStart + superframe - position) % superframe;
+}
+
+void ZHNetwork::restoreRoutingState()
+{
+    routing_snapshot_t snapshot;
+#if defined(ESP8266)
+    if (!ESP.rtcUserMemoryRead(32, (uint32_t *)&snapshot, sizeof(routing_snapshot_t)))
+        return;
+#endif
+#if defined(ESP32)
+    memcpy((void *)&snapshot, &routingSnapshot, sizeof(routing_snapshot_t));
+#endif
+    uint32_t checksum = snapshot.checksum;
+    snapshot.checksum = 0;
+    if (snapshot.signature != 0x485A || snapshot.version != 1 || snapshot.numberOfRoutes > 24 || checksum != getChecksum((uint8_t *)&snapshot, sizeof(routing_snapshot_t)))
+        return;
+    routingVector.clear();
+    for (uint8_t i{0}; i < snapshot.numberOfRoutes; ++i)
+        routingVector.push_back(snapshot.routingTable[i]);
+    messageSequence = snapshot.messageSequence;
+    sequenceReservation = snapshot.messageSequence;
+    if (!gateway_ && snapshot.gatewayHops)
+    {
+        memcpy(&gatewayMAC, &snapshot.gatewayMAC, 6);
+        memcpy(&parentMAC, &snapshot.parentMAC, 6);
+        gatewayHops = snapshot.gatewayHops;
+        gatewayBeaconInterval_ = snapshot.gatewayBeaconInterval;
+        lastGatewayBeaconTime = millis();
+    }
+    lastRoutingSnapshotChecksum = checksum;
+#ifdef PRINT_LOG
+    Serial.print(F("CHECKING ROUTING TABLE... "));
+    Serial.print(snapshot.numberOfRoutes);
+    Serial.println(F(" routes restored."));
+#endif
+}
+
+uint32_t ZHNetwork::getChecksum(const uint8_t *data, const uint16_t length)
+{
+    uint32_t checksum{2166136261UL};
+    for (uint16_t i{0}; i < length; ++i)
+        checksum = (checksum ^ data[i]) * 16777619UL;
+    return checksum;
+}
+
+uint16_t ZHNetwork::getNextMessageID()
+{
+    if (!++messageSequence)
+        ++messageSequence;
+    return messageSequence;
+}
+
+void ZHNetwork::trackMessage(const uint16_t messageID, message_type_t type, on_status_t onStatusCallback)
+{
+    if (trackingVector.size() >= ZHNETWORK_TRACKED_MESSAGES)
+    {
+        uint16_t index{0};
+        for (uint16_t i{0}; i < trackingVector.size(); ++i)
+        {
+            message_tracking_t trackingData = trackingVector[i];
+            if (trackingData.status != MESSAGE_QUEUED && !(trackingData.status == MESSAGE_SENT && trackingData.messageType == UNICAST_WITH_CONFIRM))
+            {
+                index = i;
+                break;
+            }
+        }
+        trackingVector.erase(trackingVector.begin() + index);
+    }
+    message_tracking_t trackingData;
+    trackingData.messageID = messageID;
+    trackingData.messageType = type;
+    trackingData.status = MESSAGE_QUEUED;
+    trackingData.onStatusCallback = onStatusCallback;
+    trackingVector.push_back(trackingData);
+}
+
+void ZHNetwork::updateMessageStatus(const uint16_t messageID, message_status_t status)
+{
+    for (uint16_t i{0}; i < trackingVector.size(); ++i)
+    {
+        if (trackingVector[i].messageID == messageID)
+        {
+            if (trackingVector[i].status == status)
+                return;
+            trackingVector[i].status = status;
+            on_status_t onStatusCallback = trackingVector[i].onStatusCallback;
+            if (onStatusCallback)
+                onStatusCallback(messageID, status);
+            return;
+        }
+    }
+}
+
+void ZHNetwork::processBridge()
+{
+    if (!bridgeStream)
+        return;
+    for (int available = bridgeStream->available(); available > 0; --available)
+    {
+        uint8_t byte = bridgeStream->read();
+        if (byte)
+        {
+            if (bridgeRxBuffer.size() < ZHNETWORK_BRIDGE_FRAME_SIZE)
+                bridgeRxBuffer.push_back(byte);
+            else
+                bridgeRxOverflow = true;
+            continue;
+        }
+        uint16_t length = bridgeRxOverflow ? 0 : decodeCOBS(bridgeRxBuffer.data(), bridgeRxBuffer.size());
+        if (length > 2 && getCRC16(bridgeRxBuffer.data(), length - 2) == (bridgeRxBuffer[length - 2] | bridgeRxBuffer[length - 1] << 8))
+            processBridgeFrame(bridgeRxBuffer.data(), length - 2);
+        else if (!bridgeRxBuffer.empty() || bridgeRxOverflow)
+        {
+            ++statistics.bridgeErrors;
+#ifdef PRINT_LOG
+            Serial.println(F("CHECKING BRIDGE... Broken frame received."));
+#endif
+        }
+        bridgeRxBuffer.clear();
+        bridgeRxOverflow = false;
+    }
+    if (bridgeStatisticsInterval_ && (millis() - lastBridgeStatisticsTime) > bridgeStatisticsInterval_ * 1000UL)
+    {
+        bridgeStatistics();
+        lastBridgeStatisticsTime = millis();
+    }
+    while (bridgeTxHead != bridgeTxTail)
+    {
+        int space = bridgeStream->availableForWrite();
+        if (space <= 0)
+            break;
+        uint16_t length = (bridgeTxHead > bridgeTxTail ? bridgeTxHead : bridgeTxBuffer.size()) - bridgeTxTail;
+        if (length > space)
+            length = space;
+        length = bridgeStream->write(bridgeTxBuffer.data() + bridgeTxTail, length);
+        if (!length)
+            break;
+        bridgeTxTail = (bridgeTxTail + length) % bridgeTxBuffer.size();
+    }
+}
+
+void ZHNetwork::processBridgeFrame(const uint8_t *data, const uint16_t length)
+{
+    switch (data[0])
+    {
+    case BRIDGE_SEND:
+        // Batch of records: type (1), reference (2), target MAC or group (6), length (1), data (length).
+        for (uint16_t i{1}; i < length;)
+        {
+            if (i + 10 > length || i + 10 + data[i + 9] > length)
+            {
+                ++statistics.bridgeErrors; // Truncated record. Following records can not be found.
+                break;
+            }
+            uint8_t type = data[i];
+            uint16_t reference = data[i + 1] | data[i + 2] << 8;
+            uint8_t target[6]{0};
+            memcpy(&target, data + i + 3, 6);
+            uint8_t messageLength = data[i + 9];
+            char message[ZHNETWORK_MAX_MESSAGE_LENGTH]{0};
+            if (messageLength < ZHNETWORK_MAX_MESSAGE_LENGTH)
+                memcpy(&message, data + i + 10, messageLength);
+            else
+                type = 0; // Too long message is skipped. Result is sent with message ID 0.
+            i += 10 + messageLength;
+            on_status_t onStatusCallback = [this](const uint16_t messageID, const message_status_t status)
+            { bridgeStatus(messageID, status); };
+            uint16_t messageID{0};
+            switch (type)
+            {
+            case BROADCAST:
+                messageID = sendBroadcastMessage(message, onStatusCallback);
+                break;
+            case UNICAST:
+            case UNICAST_WITH_CONFIRM:
+                messageID = sendUnicastMessage(message, target, type == UNICAST_WITH_CONFIRM, onStatusCallback);
+                break;
+            case GROUP_MESSAGE:
+                messageID = sendGroupMessage(message, target[0] | target[1] << 8, onStatusCallback);
+                break;
+            default:
+                ++statistics.bridgeErrors;
+                break;
+            }
+            uint8_t result[5]{BRIDGE_SEND_RESULT, (uint8_t)reference, (uint8_t)(reference >> 8), (uint8_t)messageID, (uint8_t)(messageID >> 8)};
+            sendBridgeFrame(result, sizeof(result));
+        }
+        break;
+    case BRIDGE_GET_STATISTICS:
+        bridgeStatistics();
+        break;
+    default:
+        ++statistics.bridgeErrors;
+        break;
+    }
+}
+
+void ZHNetwork::sendBridgeFrame(const uint8_t *data, const uint16_t length)
+{
+    if (!bridgeStream)
+        return;
+    uint8_t frame[ZHNETWORK_MAX_MESSAGE_LENGTH + 32];
+    memcpy(&frame, data, length);
+    uint16_t crc = getCRC16(data, length);
+    frame[length] = crc & 0xFF;
+    frame[length + 1] = crc >> 8;
+    uint8_t encoded[sizeof(frame) + 3];
+    uint16_t encodedLength = encodeCOBS(frame, length + 2, encoded);
+    encoded[encodedLength++] = 0;
+    uint16_t size = bridgeTxBuffer.size();
+    if (encodedLength > (bridgeTxTail + size - bridgeTxHead - 1) % size)
+    {
+        ++statistics.bridgeOverflows;
+        return;
+    }
+    for (uint16_t i{0}; i < encodedLength; ++i)
+    {
+        bridgeTxBuffer[bridgeTxHead] = encoded[i];
+        bridgeTxHead = (bridgeTxHead + 1) % size;
+    }
+}
+
+void ZHNetwork::bridgeMessage(const transmitted_data_t &transmittedData, const uint16_t group)
+{
+    if (!bridgeStream)
+        return;
+    // Type (1), message type (1), message ID (2), sender MAC (6), group (2), length (1), data (length).
+    uint8_t frame[13 + ZHNETWORK_MAX_MESSAGE_LENGTH];
+    uint8_t length = strnlen(transmittedData.message, ZHNETWORK_MAX_MESSAGE_LENGTH - 1);
+    frame[0] = BRIDGE_MESSAGE;
+    frame[1] = transmittedData.messageType;
+    frame[2] = transmittedData.messageID & 0xFF;
+    frame[3] = transmittedData.messageID >> 8;
+    memcpy(&frame[4], &transmittedData.originalSenderMAC, 6);
+    frame[10] = group & 0xFF;
+    frame[11] = group >> 8;
+    frame[12] = length;
+    memcpy(&frame[13], &transmittedData.message, length);
+    sendBridgeFrame(frame, 13 + length);
+}
+
+void ZHNetwork::bridgeStatus(const uint16_t messageID, const message_status_t status)
+{
+    uint8_t frame[4]{BRIDGE_STATUS, (uint8_t)messageID, (uint8_t)(messageID >> 8), (uint8_t)status};
+    sendBridgeFrame(frame, sizeof(frame));
+}
+
+void ZHNetwork::bridgeStatistics()
+{
+    uint8_t frame[1 + sizeof(statistics_t)]{BRIDGE_STATISTICS};
+    memcpy(&frame[1], &statistics, sizeof(statistics_t)); // Little-endian uint32_t fields.
+    sendBridgeFrame(frame, sizeof(frame));
+}
+
+uint16_t ZHNetwork::getCRC16(const uint8_t *data, const uint16_t length)
+{
+    uint16_t crc{0xFFFF}; // CRC-16/CCITT-FALSE.
+    for (uint16_t i{0}; i < length; ++i)
+    {
+        crc ^= data[i] << 8;
+        for (uint8_t j{0}; j < 8; ++j)
+            crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+    return crc;
+}
+
+uint16_t ZHNetwork::encodeCOBS(const uint8_t *data, const uint16_t length, uint8_t *encoded)
+{
+    uint16_t codeIndex{0};
+    uint16_t encodedLength{1};
+    uint8_t code{1};
+    for (uint16_t i{0}; i < length; ++i)
+    {
+        if (data[i])
+        {
+            encoded[encodedLength++] = data[i];
+            ++code;
+        }
+        if (!data[i] || code == 0xFF)
+        {
+            encoded[codeIndex] = code;
+            code = 1;
+            codeIndex = encodedLength++;
+        }
+    }
+    encoded[codeIndex] = code;
+    return encodedLength;
+}
+
+uint16_t ZHNetwork::decodeCOBS(uint8_t *data, const uint16_t length)
+{
+    uint16_t decodedLength{0};
+    for (uint16_t i{0}; i < length;)
+    {
+        uint8_t code = data[i++];
+        if (!code || i + code - 1 > length)
+            return 0;
+        for (uint8_t j{1}; j < code; ++j)
+            data[decodedLength++] = data[i++];
+        if (code < 0xFF && i < length)
+            data[decodedLength++] = 0;
+    }
+    return decodedLength;
+}
@@ -2,7 +2,7 @@
 #define ZHNETWORK_H
 
 #include "Arduino.h"
-#include <queue>
+#include <deque>
 #if defined(ESP8266)
 #include "ESP8266WiFi.h"
 #include "espnow.h"
@@ -14,15 +14,52 @@
 #endif
 
 // #define PRINT_LOG // Uncomment to display to serial port the full operation log.
+// #define ZHNETWORK_LEAF_NODE // Uncomment to compile out forwarding of messages of other nodes (for end devices only).
+// #define ZHNETWORK_NO_CRYPT // Uncomment to compile out messages crypting.
+// #define ZHNETWORK_NO_CONFIRM // Uncomment to compile out sending of unicast messages with confirm.
+// #define ZHNETWORK_NO_COMPRESSION // Uncomment to compile out messages compression (compressed messages will be ignored).
+
+#ifndef ZHNETWORK_MAX_MESSAGE_LENGTH
+#define ZHNETWORK_MAX_MESSAGE_LENGTH 200 // 16-214 bytes. Must be the same for all nodes in network.
+#endif
+#ifndef ZHNETWORK_ROUTING_TABLE_SIZE
+#define ZHNETWORK_ROUTING_TABLE_SIZE 100 // Max number of routes. The least recently used route is replaced if the table is full.
+#endif
+#ifndef ZHNETWORK_GATEWAY_ROUTING_TABLE_SIZE
+#define ZHNETWORK_GATEWAY_ROUTING_TABLE_SIZE 300 // Max number of routes on gateway (not used with ZHNETWORK_LEAF_NODE). Should be not less than number of nodes sending to gateway.
+#endif
+#ifndef ZHNETWORK_DUPLICATE_FILTER_SIZE
+#define ZHNETWORK_DUPLICATE_FILTER_SIZE 20 // Max number of senders checked for duplicate messages.
+#endif
+#ifndef ZHNETWORK_QUEUE_SIZE
+#define ZHNETWORK_QUEUE_SIZE 20 // 1-255. Max number of messages in each of incoming, outgoing and routing waiting queues.
+#endif
+#ifndef ZHNETWORK_TRACKED_MESSAGES
+#define ZHNETWORK_TRACKED_MESSAGES 20 // Max number of sent messages with stored status.
+#endif
+#ifndef ZHNETWORK_BRIDGE_BUFFER_SIZE
+#define ZHNETWORK_BRIDGE_BUFFER_SIZE 2048 // Size of serial bridge transmit buffer (allocated only if bridge is started).
+#endif
+#ifndef ZHNETWORK_BRIDGE_FRAME_SIZE
+#define ZHNETWORK_BRIDGE_FRAME_SIZE 512 // Max size of encoded frame received by serial bridge from host.
+#endif
+
+#if ZHNETWORK_MAX_MESSAGE_LENGTH < 16 || ZHNETWORK_MAX_MESSAGE_LENGTH > 214
+#error "ZHNETWORK_MAX_MESSAGE_LENGTH must be 16-214 bytes (ESP-NOW frame is limited to 250 bytes)."
+#endif
+#if ZHNETWORK_QUEUE_SIZE < 1 || ZHNETWORK_QUEUE_SIZE > 255
+#error "ZHNETWORK_QUEUE_SIZE must be 1-255 messages."
+#endif
 
 typedef struct
 {
     uint8_t messageType{0};
+    uint8_t messageFlags{0};
     uint16_t messageID{0};
     char netName[20]{0};
     uint8_t originalTargetMAC[6]{0};
     uint8_t originalSenderMAC[6]{0};
-    char message[200]{0};
+    char message[ZHNETWORK_MAX_MESSAGE_LENGTH]{0};
 } transmitted_data_t;
 
 typedef struct
@@ -33,6 +70,7 @@ typedef struct
 
 typedef struct
 {
+    uint32_t time{0}; // millis() at reception.
     uint8_t intermediateSenderMAC[6]{0};
     transmitted_data_t transmittedData;
 } incoming_data_t;
@@ -50,10 +88,32 @@ typedef struct
     uint8_t intermediateTargetMAC[6]{0};
 } routing_table_t;
 
+typedef struct
+{
+    uint16_t signature{0};
+    uint8_t version{0};
+    uint8_t numberOfRoutes{0};
+    uint16_t messageSequence{0};
+    uint16_t gatewayBeaconInterval{0};
+    uint8_t gatewayMAC[6]{0};
+    uint8_t parentMAC[6]{0};
+    uint8_t gatewayHops{0};
+    uint8_t reserved[3]{0};
+    uint32_t checksum{0};
+    routing_table_t routingTable[24];
+} routing_snapshot_t; // Must be a multiple of 4 bytes and no more than 384 bytes (ESP8266 RTC user memory without OTA area).
+
+typedef struct
+{
+    uint8_t senderMAC[6]{0};
+    uint16_t lastMessageID{0};
+    uint32_t receivedMessages{0}; // Bitmap of 32 message IDs preceding the last one.
+} duplicate_filter_t;
+
 typedef struct
 {
     uint16_t messageID{0};
-    char empty[198]{0}; // Just only to prevent compiler warnings.
+    char empty[ZHNETWORK_MAX_MESSAGE_LENGTH - 2]{0}; // Just only to prevent compiler warnings.
 } confirmation_id_t;
 
 typedef struct
@@ -63,6 +123,29 @@ typedef struct
     uint16_t messageID{0};
 } confirmation_waiting_data_t;
 
+typedef struct
+{
+    uint16_t interval{0};
+    uint8_t hops{0};
+    uint8_t slotCount{0};
+    uint32_t time{0}; // Network time (gateway millis()) at the moment of transmission.
+    uint8_t slotLength{0};
+    char empty[ZHNETWORK_MAX_MESSAGE_LENGTH - 9]{0}; // Just only to prevent compiler warnings.
+} gateway_beacon_t;
+
+typedef struct
+{
+    uint16_t group{0};
+    char empty[ZHNETWORK_MAX_MESSAGE_LENGTH - 2]{0}; // Just only to prevent compiler warnings.
+} group_id_t;
+
+typedef struct
+{
+    uint32_t time{0};
+    uint16_t group{0};
+    uint8_t nextHopMAC[6]{0};
+} group_routing_t;
+
 typedef enum
 {
     BROADCAST = 1,
@@ -70,9 +153,84 @@ typedef enum
     UNICAST_WITH_CONFIRM,
     DELIVERY_CONFIRM_RESPONSE,
     SEARCH_REQUEST,
-    SEARCH_RESPONSE
+    SEARCH_RESPONSE,
+    GATEWAY_BEACON,
+    GROUP_JOIN,
+    GROUP_MESSAGE
 } message_type_t;
 
+typedef enum
+{
+    MESSAGE_COMPRESSED = 0x01
+} message_flag_t;
+
+typedef enum
+{
+    MESSAGE_UNKNOWN = 0,
+    MESSAGE_QUEUED,
+    MESSAGE_SENT,
+    MESSAGE_DELIVERED,
+    MESSAGE_FAILED_NO_ROUTE,
+    MESSAGE_FAILED_NO_CONFIRM,
+    MESSAGE_FAILED_QUEUE_FULL
+} message_status_t;
+
+typedef enum
+{
+    SEND_OK = 0,
+    SEND_QUEUE_FULL,
+    SEND_MESSAGE_TOO_LONG,
+    SEND_NOT_SUPPORTED
+} send_error_t;
+
+typedef enum
+{
+    DROP_NEWEST = 1,
+    DROP_OLDEST,
+    DROP_DATA_FIRST
+} drop_policy_t;
+
+typedef struct
+{
+    uint8_t incoming{ZHNETWORK_QUEUE_SIZE};
+    uint8_t outgoing{ZHNETWORK_QUEUE_SIZE};
+    uint8_t routingWaiting{ZHNETWORK_QUEUE_SIZE};
+    drop_policy_t dropPolicy{DROP_NEWEST};
+} queue_limits_t;
+
+typedef struct
+{
+    uint8_t incoming{10};
+    uint8_t forwarding{10};
+    uint8_t routingWaiting{10};
+    uint8_t confirmation{10};
+    uint16_t timeSlice{0};
+} maintenance_budget_t;
+
+typedef enum
+{
+    BRIDGE_MESSAGE = 0x01,
+    BRIDGE_SEND_RESULT,
+    BRIDGE_STATUS,
+    BRIDGE_STATISTICS,
+    BRIDGE_SEND = 0x81,
+    BRIDGE_GET_STATISTICS
+} bridge_frame_type_t;
+
+typedef struct
+{
+    uint32_t receivedFrames{0};
+    uint32_t duplicateFrames{0};
+    uint32_t droppedFrames{0}; // Received frames not queued (incoming queue full or busy).
+    uint32_t sentFrames{0};
+    uint32_t failedTransmissions{0};
+    uint32_t bridgeErrors{0};
+    uint32_t bridgeOverflows{0};
+    uint32_t slottedTransmissions{0};
+    uint32_t floodFramesSent{0};     // Broadcast, search and beacon frames sent (including forwarded).
+    uint32_t floodFramesReceived{0}; // Broadcast, search and beacon frames received (including duplicates).
+} statistics_t;
+
 typedef enum // Just for further development.
 {
     SUCCESS = 1,
@@ -80,28 +238,52 @@ typedef enum // Just for further development.
 } error_code_t;
 
 typedef std::function<void(const char *, const uint8_t *)> on_message_t;
+typedef std::function<void(const char *, const uint8_t *, const uint16_t)> on_group_message_t;
 typedef std::function<void(const uint8_t *, const uint16_t, const bool)> on_confirm_t;
+typedef std::function<void(const uint16_t, const message_status_t)> on_status_t;
+
+typedef struct
+{
+    uint16_t messageID{0};
+    uint8_t messageType{0};
+    message_status_t status{MESSAGE_UNKNOWN};
+    on_status_t onStatusCallback;
+} message_tracking_t;
+
 typedef std::vector<routing_table_t> routing_vector_t;
 typedef std::vector<confirmation_waiting_data_t> confirmation_vector_t;
-typedef std::queue<outgoing_data_t> outgoing_queue_t;
-typedef std::queue<incoming_data_t> incoming_queue_t;
-typedef std::queue<waiting_data_t> waiting_queue_t;
+typedef std::vector<message_tracking_t> tracking_vector_t;
+typedef std::vector<group_routing_t> group_routing_vector_t;
+typedef std::deque<outgoing_data_t> outgoing_queue_t;
+typedef std::deque<incoming_data_t> incoming_queue_t;
+typedef std::deque<waiting_data_t> waiting_queue_t;
 
 class ZHNetwork
 {
 public:
     ZHNetwork &setOnBroadcastReceivingCallback(on_message_t onBroadcastReceivingCallback);
     ZHNetwork &setOnUnicastReceivingCallback(on_message_t onUnicastReceivingCallback);
+    ZHNetwork &setOnGroupReceivingCallback(on_group_message_t onGroupReceivingCallback);
     ZHNetwork &setOnConfirmReceivingCallback(on_confirm_t onConfirmReceivingCallback);
 
     error_code_t begin(const char *netName = "", const bool gateway = false);
 
-    uint16_t sendBroadcastMessage(const char *data);
-    uint16_t sendUnicastMessage(const char *data, const uint8_t *target, const bool confirm = false);
+    uint16_t sendBroadcastMessage(const char *data, on_status_t onStatusCallback = nullptr);
+    uint16_t sendUnicastMessage(const char *data, const uint8_t *target, const bool confirm = false, on_status_t onStatusCallback = nullptr);
+    uint16_t sendGroupMessage(const char *data, const uint16_t group, on_status_t onStatusCallback = nullptr);
+    message_status_t getMessageStatus(const uint16_t messageID);
+    send_error_t getLastSendError(void);
+
+    error_code_t joinGroup(const uint16_t group);
+    error_code_t leaveGroup(const uint16_t group);
 
     void maintenance(void);
+#if defined(ESP32)
+    error_code_t startMaintenanceTask(const uint8_t core = 1, const uint8_t priority = 1, const uint32_t stackSize = 8192);
+#endif
 
     String getNodeMac(void);
+    String getGatewayMac(void);
     String getFirmwareVersion(void);
     String readErrorCode(error_code_t code); // Just for further development.
 
@@ -115,6 +297,34 @@ public:
     uint8_t getMaxWaitingTimeBetweenTransmissions(void);
     error_code_t setMaxWaitingTimeForRoutingInfo(const uint16_t maxTimeForRoutingInfoWaiting);
     uint16_t getMaxWaitingTimeForRoutingInfo(void);
+    error_code_t setRoutingPersistence(const bool routingPersistence);
+    bool getRoutingPersistence(void);
+    error_code_t saveRoutingState(void);
+    error_code_t setGatewayBeaconInterval(const uint16_t gatewayBeaconInterval);
+    uint16_t getGatewayBeaconInterval(void);
+    error_code_t setSlottedTransmission(const uint8_t slotLength, const uint8_t slotCount);
+    uint8_t getSlotLength(void);
+    uint8_t getSlotCount(void);
+    bool isTimeSynchronized(void);
+    uint32_t getNetworkTime(void);
+    error_code_t setMaintenanceBudget(const maintenance_budget_t &maintenanceBudget);
+    maintenance_budget_t getMaintenanceBudget(void);
+    error_code_t setQueueLimits(const queue_limits_t &queueLimits);
+    queue_limits_t getQueueLimits(void);
+    uint8_t getOutgoingQueueSpace(void);
+    error_code_t setAdaptiveRateControl(const bool adaptiveRateControl);
+    bool getAdaptiveRateControl(void);
+    uint16_t getTransmissionInterval(void);
+    error_code_t setCompression(const bool compression);
+    bool getCompression(void);
+#ifndef ZHNETWORK_NO_COMPRESSION
+    static uint8_t compressMessage(const char *data, uint8_t *compressed);
+    static bool decompressMessage(const uint8_t *compressed, const uint8_t length, char *data);
+#endif
+    statistics_t getStatistics(void);
+
+    error_code_t startBridge(Stream &stream, const uint16_t statisticsInterval = 10);
+    void stopBridge(void);
 
 private:
     static routing_vector_t routingVector;
@@ -122,23 +332,71 @@ private:
     static incoming_queue_t queueForIncomingData;
     static outgoing_queue_t queueForOutgoingData;
     static waiting_queue_t queueForRoutingVectorWaiting;
+    static tracking_vector_t trackingVector;
 
     static bool criticalProcessSemaphore;
     static bool sentMessageSemaphore;
     static bool confirmReceivingSemaphore;
     static bool confirmReceiving;
     static uint8_t localMAC[6];
-    static uint16_t lastMessageID[10];
-    static char netName_[20];
-    static char key_[20];
+    static duplicate_filter_t duplicateFilter[ZHNETWORK_DUPLICATE_FILTER_SIZE];
+    static uint16_t messageSequence;
+    static queue_limits_t queueLimits_;
+    static statistics_t statistics;
+    static char netName_[21];
+    static char key_[21];
+#if defined(ESP32)
+    static TaskHandle_t maintenanceTaskHandle;
+    static SemaphoreHandle_t maintenanceMutex;
+    static portMUX_TYPE incomingQueueSpinlock;
+#endif
 
-    const char *firmware{"1.42"};
+    const char *firmware{"1.43"};
     const uint8_t broadcastMAC[6]{0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+    const uint8_t groupMAC[6]{0x01, 0x00, 0x5E, 0x00, 0x00, 0x00}; // Last 2 bytes are group ID.
     uint8_t maxNumberOfAttempts_{3};
     uint8_t maxWaitingTimeBetweenTransmissions_{50};
+    uint16_t transmissionInterval{50};
+    bool adaptiveRateControl_{true};
+    bool compression_{false};
+    bool droppingMessages{false};
+    send_error_t lastSendError_{SEND_OK};
+    Stream *bridgeStream{nullptr};
+    uint16_t bridgeStatisticsInterval_{10};
+    uint32_t lastBridgeStatisticsTime{0};
+    std::vector<uint8_t> bridgeTxBuffer;
+    uint16_t bridgeTxHead{0};
+    uint16_t bridgeTxTail{0};
+    std::vector<uint8_t> bridgeRxBuffer;
+    bool bridgeRxOverflow{false};
     uint8_t numberOfAttemptsToSend{1};
     uint16_t maxTimeForRoutingInfoWaiting_{500};
     uint32_t lastMessageSentTime{0};
+    uint32_t lastForwardingTime{0};
+    bool gateway_{false};
+    uint8_t gatewayMAC[6]{0};
+    uint8_t parentMAC[6]{0};
+    uint8_t gatewayHops{0};
+    uint16_t gatewayBeaconInterval_{60};
+    uint32_t lastGatewayBeaconTime{0};
+    uint8_t slotLength_{0};
+    uint8_t slotCount_{0};
+    uint32_t networkTimeOffset{0};
+    bool timeSynchronized{false};
+    std::vector<uint16_t> groupVector;
+    group_routing_vector_t groupRoutingVector;
+    bool groupJoinPending{false};
+    uint32_t lastGroupJoinTime{0};
+    uint32_t groupJoinDelay{0};
+    bool routingPersistence_{false};
+    uint16_t sequenceReservation{0};
+    uint32_t lastRoutingSnapshotTime{0};
+    uint32_t lastRoutingSnapshotChecksum{0};
+#if defined(ESP32)
+    static uint32_t routingSnapshot[sizeof(routing_snapshot_t) / 4];
+#endif
+    uint8_t forwardingDelay{0};
+    maintenance_budget_t maintenanceBudget_;
 
 #if defined(ESP8266)
     static void onDataSent(uint8_t *mac, uint8_t status);
@@ -148,10 +406,56 @@ private:
     static void onDataSent(const uint8_t *mac, esp_now_send_status_t status);
     static void onDataReceive(const uint8_t *mac, const uint8_t *data, int length);
 #endif
+#if defined(ESP32)
+    static void maintenanceTask(void *parameter);
+#endif
+    static void lock(void);
+    static void unlock(void);
+    static void notifyMaintenanceTask(void);
+    static void cryptMessage(char *message, const uint8_t length);
+    void packMessage(transmitted_data_t &transmittedData, const char *data);
+    static bool unpackMessage(transmitted_data_t &transmittedData);
+#ifndef ZHNETWORK_NO_COMPRESSION
+    static uint8_t getCompressionByte(const uint8_t *data, const uint16_t index);
+#endif
+    static bool isDuplicate(const uint8_t *senderMAC, const uint16_t messageID);
+    static bool isFloodMessage(const uint8_t messageType);
+    static bool isControlMessage(const uint8_t messageType);
+    template <typename T>
+    static int16_t getDropIndex(const std::deque<T> &queue, const T &data, const uint8_t firstIndex);
+    static bool pushIncomingData(const incoming_data_t &incomingData);
+    static bool popIncomingData(incoming_data_t &incomingData);
+    bool pushOutgoingData(const outgoing_data_t &outgoingData);
+    bool pushWaitingData(const waiting_data_t &waitingData);
+    void dropMessage(const transmitted_data_t &transmittedData);
+    uint32_t getTimeToNextEvent(void);
+    bool isTimeSliceExceeded(const uint32_t startTime);
     uint16_t broadcastMessage(const char *data, const uint8_t *target, message_type_t type);
-    uint16_t unicastMessage(const char *data, const uint8_t *target, const uint8_t *sender, message_type_t type);
+    uint16_t unicastMessage(const char *data, const uint8_t *target, message_type_t type);
+    bool routeMessage(outgoing_data_t &outgoingData);
+    uint8_t multicastMessage(const transmitted_data_t &transmittedData, const uint8_t *senderMAC);
+    bool isGroupMember(const uint16_t group);
+    static uint16_t macToGroup(const uint8_t *mac);
+    bool findRoute(const uint8_t *target, uint8_t *intermediateTargetMAC);
+    bool isParentAvailable(void);
+    uint32_t getTimeToSlot(void);
+    void restoreRoutingState(void);
+    static uint32_t getChecksum(const uint8_t *data, const uint16_t length);
+    uint16_t getNextMessageID(void);
+    void processBridge(void);
+    void processBridgeFrame(const uint8_t *data, const uint16_t length);
+    void sendBridgeFrame(const uint8_t *data, const uint16_t length);
+    void bridgeMessage(const transmitted_data_t &transmittedData, const uint16_t group);
+    void bridgeStatus(const uint16_t messageID, const message_status_t status);
+    void bridgeStatistics(void);
+    static uint16_t getCRC16(const uint8_t *data, const uint16_t length);
+    static uint16_t encodeCOBS(const uint8_t *data, const uint16_t length, uint8_t *encoded);
+    static uint16_t decodeCOBS(uint8_t *data, const uint16_t length);
+    void trackMessage(const uint16_t messageID, message_type_t type, on_status_t onStatusCallback);
+    void updateMessageStatus(const uint16_t messageID, message_status_t status);
     on_message_t onBroadcastReceivingCallback;
     on_message_t onUnicastReceivingCallback;
+    on_group_message_t onGroupReceivingCallback;
     on_confirm_t onConfirmReceivingCallback;
 
 protected: